@@ -0,0 +1,570 @@
+/*
+* Headless stand-in for VulkanExampleBase
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "headlessexamplebase.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+std::vector<const char*> VulkanExampleBase::args;
+
+VulkanExampleBase::VulkanExampleBase(bool enableValidation)
+{
+	settings.validation = enableValidation;
+
+	// Command line arguments
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		std::string arg = args[i];
+		bool hasValue = (i + 1 < args.size());
+		if (arg == "-validation" || arg == "--validation") {
+			settings.validation = true;
+		}
+		if ((arg == "-w" || arg == "-width" || arg == "--width") && hasValue) {
+			width = static_cast<uint32_t>(strtol(args[++i], nullptr, 10));
+		}
+		else if ((arg == "-h" || arg == "-height" || arg == "--height") && hasValue) {
+			height = static_cast<uint32_t>(strtol(args[++i], nullptr, 10));
+		}
+		else if ((arg == "-f" || arg == "--frames") && hasValue) {
+			benchmarkSettings.frames = static_cast<uint32_t>(strtol(args[++i], nullptr, 10));
+		}
+		else if (arg == "--warmup" && hasValue) {
+			benchmarkSettings.warmup = static_cast<uint32_t>(strtol(args[++i], nullptr, 10));
+		}
+		else if ((arg == "-t" || arg == "--threads") && hasValue) {
+			benchmarkSettings.threads = static_cast<uint32_t>(strtol(args[++i], nullptr, 10));
+		}
+		else if ((arg == "-g" || arg == "--gpu") && hasValue) {
+			benchmarkSettings.gpu = static_cast<int32_t>(strtol(args[++i], nullptr, 10));
+		}
+		else if ((arg == "-o" || arg == "--output") && hasValue) {
+			benchmarkSettings.output = args[++i];
+		}
+	}
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	benchmarkSettings.frames = std::max(benchmarkSettings.frames, 1u);
+}
+
+VulkanExampleBase::~VulkanExampleBase()
+{
+	if (descriptorPool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	}
+	destroyCommandBuffers();
+	vkDestroyRenderPass(device, renderPass, nullptr);
+	for (uint32_t i = 0; i < frameBuffers.size(); i++)
+	{
+		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
+	}
+	for (auto& shaderModule : shaderModules)
+	{
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+	}
+	for (auto& colorImage : colorImages)
+	{
+		destroyOffscreenImage(colorImage);
+	}
+	vkDestroyImageView(device, depthStencil.view, nullptr);
+	vkDestroyImage(device, depthStencil.image, nullptr);
+	vkFreeMemory(device, depthStencil.mem, nullptr);
+
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
+	vkDestroyCommandPool(device, cmdPool, nullptr);
+
+	delete vulkanDevice;
+
+	vkDestroyInstance(instance, nullptr);
+}
+
+VkResult VulkanExampleBase::createInstance(bool enableValidation)
+{
+	this->settings.validation = enableValidation;
+
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = name.c_str();
+	appInfo.pEngineName = name.c_str();
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	// No surface extensions, nothing is presented
+	std::vector<const char*> instanceExtensions = enabledInstanceExtensions;
+	std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
+
+	VkInstanceCreateInfo instanceCreateInfo = {};
+	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceCreateInfo.pNext = NULL;
+	instanceCreateInfo.pApplicationInfo = &appInfo;
+	if (instanceExtensions.size() > 0)
+	{
+		instanceCreateInfo.enabledExtensionCount = (uint32_t)instanceExtensions.size();
+		instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions.data();
+	}
+	if (settings.validation)
+	{
+		instanceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+		instanceCreateInfo.ppEnabledLayerNames = validationLayers.data();
+	}
+	return vkCreateInstance(&instanceCreateInfo, nullptr, &instance);
+}
+
+bool VulkanExampleBase::initVulkan()
+{
+	VkResult err;
+
+	// llvmpipe (lavapipe) picks its rasterizer thread count up when the device is created
+	if (benchmarkSettings.threads > 0)
+	{
+		std::string threads = std::to_string(benchmarkSettings.threads);
+#if defined(_WIN32)
+		_putenv_s("LP_NUM_THREADS", threads.c_str());
+#else
+		setenv("LP_NUM_THREADS", threads.c_str(), 1);
+#endif
+	}
+
+	err = createInstance(settings.validation);
+	if (err) {
+		std::cerr << "Could not create Vulkan instance : " << vks::tools::errorString(err) << std::endl;
+		return false;
+	}
+
+	// Physical device
+	uint32_t gpuCount = 0;
+	VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr));
+	if (gpuCount == 0) {
+		std::cerr << "No device with Vulkan support found" << std::endl;
+		return false;
+	}
+	std::vector<VkPhysicalDevice> physicalDevices(gpuCount);
+	err = vkEnumeratePhysicalDevices(instance, &gpuCount, physicalDevices.data());
+	if (err) {
+		std::cerr << "Could not enumerate physical devices : " << vks::tools::errorString(err) << std::endl;
+		return false;
+	}
+
+	uint32_t selectedDevice = 0;
+	if (benchmarkSettings.gpu >= 0)
+	{
+		if (static_cast<uint32_t>(benchmarkSettings.gpu) < gpuCount) {
+			selectedDevice = static_cast<uint32_t>(benchmarkSettings.gpu);
+		}
+		else {
+			std::cerr << "Selected device index " << benchmarkSettings.gpu << " is out of range, reverting to device 0" << std::endl;
+		}
+	}
+
+	physicalDevice = physicalDevices[selectedDevice];
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
+
+	// Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
+	getEnabledFeatures();
+
+	vulkanDevice = new vks::VulkanDevice(physicalDevice);
+	VkResult res = createLogicalDevice();
+	if (res != VK_SUCCESS) {
+		std::cerr << "Could not create Vulkan device : " << vks::tools::errorString(res) << std::endl;
+		return false;
+	}
+	device = vulkanDevice->logicalDevice;
+
+	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+
+	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
+	assert(validDepthFormat);
+
+	// No semaphores, submissions are serialized by waiting for the queue in submitFrame()
+	submitInfo = vks::initializers::submitInfo();
+	submitInfo.pWaitDstStageMask = &submitPipelineStages;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.signalSemaphoreCount = 0;
+
+	return true;
+}
+
+// Same queues as vks::VulkanDevice::createLogicalDevice (graphics, plus a dedicated compute
+// family where there is one), which has no way to pass a pNext chain
+VkResult VulkanExampleBase::createLogicalDevice()
+{
+	auto &indices = vulkanDevice->queueFamilyIndices;
+	indices.graphics = vulkanDevice->getQueueFamilyIndex(VK_QUEUE_GRAPHICS_BIT);
+	indices.compute = vulkanDevice->getQueueFamilyIndex(VK_QUEUE_COMPUTE_BIT);
+	indices.transfer = indices.graphics;
+
+	const float defaultQueuePriority = 0.0f;
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+	for (uint32_t family : { indices.graphics, indices.compute })
+	{
+		if (!queueCreateInfos.empty() && queueCreateInfos[0].queueFamilyIndex == family)
+			continue;
+		VkDeviceQueueCreateInfo queueInfo{};
+		queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo.queueFamilyIndex = family;
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = &defaultQueuePriority;
+		queueCreateInfos.push_back(queueInfo);
+	}
+
+	VkDeviceCreateInfo deviceCreateInfo = {};
+	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.pNext = deviceCreatepNextChain;
+	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
+	deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
+	if (!enabledDeviceExtensions.empty())
+	{
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledDeviceExtensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = enabledDeviceExtensions.data();
+	}
+	VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &vulkanDevice->logicalDevice);
+	if (result != VK_SUCCESS)
+		return result;
+	vulkanDevice->enabledFeatures = enabledFeatures;
+	vulkanDevice->commandPool = vulkanDevice->createCommandPool(indices.graphics);
+	return VK_SUCCESS;
+}
+
+void VulkanExampleBase::viewChanged() {}
+
+void VulkanExampleBase::buildCommandBuffers() {}
+
+void VulkanExampleBase::getEnabledFeatures() {}
+
+std::string VulkanExampleBase::gpuTimingsJson(const std::string &indent)
+{
+	return "";
+}
+
+std::string VulkanExampleBase::settingsJson(const std::string &indent)
+{
+	return "";
+}
+
+void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer) {}
+
+void VulkanExampleBase::createCommandPool()
+{
+	VkCommandPoolCreateInfo cmdPoolInfo = {};
+	cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
+}
+
+void VulkanExampleBase::createCommandBuffers()
+{
+	drawCmdBuffers.resize(imageCount);
+
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+		vks::initializers::commandBufferAllocateInfo(
+			cmdPool,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			static_cast<uint32_t>(drawCmdBuffers.size()));
+
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+}
+
+void VulkanExampleBase::destroyCommandBuffers()
+{
+	if (!drawCmdBuffers.empty())
+	{
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
+	}
+}
+
+void VulkanExampleBase::createPipelineCache()
+{
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+}
+
+void VulkanExampleBase::createOffscreenImage(OffscreenImage &target, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+{
+	VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = format;
+	image.extent = { width, height, 1 };
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = VK_SAMPLE_COUNT_1_BIT;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = usage;
+	VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &target.image));
+
+	VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, target.image, &memReqs);
+	memAlloc.allocationSize = memReqs.size;
+	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &target.mem));
+	VK_CHECK_RESULT(vkBindImageMemory(device, target.image, target.mem, 0));
+
+	VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+	imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageView.format = format;
+	imageView.subresourceRange = {};
+	imageView.subresourceRange.aspectMask = aspect;
+	imageView.subresourceRange.baseMipLevel = 0;
+	imageView.subresourceRange.levelCount = 1;
+	imageView.subresourceRange.baseArrayLayer = 0;
+	imageView.subresourceRange.layerCount = 1;
+	imageView.image = target.image;
+	VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &target.view));
+}
+
+void VulkanExampleBase::destroyOffscreenImage(OffscreenImage &target)
+{
+	vkDestroyImageView(device, target.view, nullptr);
+	vkDestroyImage(device, target.image, nullptr);
+	vkFreeMemory(device, target.mem, nullptr);
+}
+
+void VulkanExampleBase::setupDepthStencil()
+{
+	OffscreenImage depth;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+		aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+	createOffscreenImage(depth, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, aspect);
+	depthStencil.image = depth.image;
+	depthStencil.mem = depth.mem;
+	depthStencil.view = depth.view;
+}
+
+void VulkanExampleBase::setupSwapChain()
+{
+	colorImages.resize(imageCount);
+	swapChain.imageCount = imageCount;
+	swapChain.buffers.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		createOffscreenImage(colorImages[i], colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		swapChain.buffers[i].image = colorImages[i].image;
+		swapChain.buffers[i].view = colorImages[i].view;
+	}
+}
+
+void VulkanExampleBase::setupFrameBuffer()
+{
+	frameBuffers.resize(swapChain.imageCount);
+	for (uint32_t i = 0; i < swapChain.imageCount; i++)
+	{
+		VkImageView attachments[2];
+		attachments[0] = swapChain.buffers[i].view;
+		attachments[1] = depthStencil.view;
+
+		VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+		frameBufferCreateInfo.renderPass = renderPass;
+		frameBufferCreateInfo.attachmentCount = 2;
+		frameBufferCreateInfo.pAttachments = attachments;
+		frameBufferCreateInfo.width = width;
+		frameBufferCreateInfo.height = height;
+		frameBufferCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[i]));
+	}
+}
+
+void VulkanExampleBase::setupRenderPass()
+{
+	std::array<VkAttachmentDescription, 2> attachments = {};
+	// Color attachment, left in a layout that can be read back
+	attachments[0].format = colorFormat;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	// Depth attachment
+	attachments[1].format = depthFormat;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+	subpassDescription.pDepthStencilAttachment = &depthReference;
+
+	// Subpass dependencies for layout transitions
+	std::array<VkSubpassDependency, 2> dependencies;
+
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+}
+
+void VulkanExampleBase::prepare()
+{
+	createCommandPool();
+	setupSwapChain();
+	createCommandBuffers();
+	setupDepthStencil();
+	setupRenderPass();
+	createPipelineCache();
+	setupFrameBuffer();
+}
+
+VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
+{
+	VkPipelineShaderStageCreateInfo shaderStage = {};
+	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStage.stage = stage;
+	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+	shaderStage.pName = "main";
+	assert(shaderStage.module != VK_NULL_HANDLE);
+	shaderModules.push_back(shaderStage.module);
+	return shaderStage;
+}
+
+void VulkanExampleBase::prepareFrame()
+{
+	currentBuffer = (currentBuffer + 1) % imageCount;
+}
+
+void VulkanExampleBase::submitFrame()
+{
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+}
+
+void VulkanExampleBase::renderLoop()
+{
+	// The scene advances by a fixed step per frame so runs are reproducible
+	const float frameStep = 1.0f / 60.0f;
+
+	auto advance = [&]() {
+		frameTimer = frameStep;
+		camera.update(frameTimer);
+		if (!paused)
+		{
+			timer += timerSpeed * frameTimer;
+			if (timer > 1.0)
+			{
+				timer -= 1.0f;
+			}
+		}
+	};
+
+	for (uint32_t i = 0; i < benchmarkSettings.warmup; i++)
+	{
+		render();
+		advance();
+	}
+
+	std::vector<double> frameTimes(benchmarkSettings.frames);
+	for (uint32_t i = 0; i < benchmarkSettings.frames; i++)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		render();
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		frameTimes[i] = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		advance();
+	}
+	// Frames may still be in flight, render() does not have to wait for the queue
+	VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (auto t : frameTimes)
+	{
+		total += t;
+	}
+	auto percentile = [&](double p) {
+		size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	};
+	const double avg = total / frameTimes.size();
+
+	std::stringstream json;
+	json << "{\n";
+	json << "\t\"device\": \"" << deviceProperties.deviceName << "\",\n";
+	json << "\t\"driverVersion\": " << deviceProperties.driverVersion << ",\n";
+	json << "\t\"width\": " << width << ",\n";
+	json << "\t\"height\": " << height << ",\n";
+	json << "\t\"threads\": " << benchmarkSettings.threads << ",\n";
+	json << "\t\"warmup\": " << benchmarkSettings.warmup << ",\n";
+	json << "\t\"frames\": " << benchmarkSettings.frames << ",\n";
+	std::string sampleSettings = settingsJson("\t");
+	if (!sampleSettings.empty())
+	{
+		json << sampleSettings << ",\n";
+	}
+	json << "\t\"frameTimesMs\": [";
+	for (size_t i = 0; i < frameTimes.size(); i++)
+	{
+		json << (i > 0 ? ", " : "") << frameTimes[i];
+	}
+	json << "],\n";
+	json << "\t\"aggregate\": {\n";
+	json << "\t\t\"totalMs\": " << total << ",\n";
+	json << "\t\t\"minMs\": " << sorted.front() << ",\n";
+	json << "\t\t\"avgMs\": " << avg << ",\n";
+	json << "\t\t\"medianMs\": " << percentile(0.5) << ",\n";
+	json << "\t\t\"p95Ms\": " << percentile(0.95) << ",\n";
+	json << "\t\t\"p99Ms\": " << percentile(0.99) << ",\n";
+	json << "\t\t\"maxMs\": " << sorted.back() << ",\n";
+	json << "\t\t\"fps\": " << 1000.0 / avg << "\n";
+	json << "\t}";
+	std::string gpuTimings = gpuTimingsJson("\t");
+	if (!gpuTimings.empty())
+	{
+		json << ",\n\t\"gpuPasses\": " << gpuTimings;
+	}
+	json << "\n}\n";
+
+	if (benchmarkSettings.output.empty())
+	{
+		std::cout << json.str();
+	}
+	else
+	{
+		std::ofstream file(benchmarkSettings.output);
+		file << json.str();
+	}
+}
@@ -0,0 +1,182 @@
+/*
+* Headless stand-in for VulkanExampleBase
+*
+* Provides the subset of the example base class interface used by scenerendering.cpp
+* without creating a window, surface or swapchain. The "swapchain" is a small ring of
+* offscreen color images, so the complete frame recorded by buildCommandBuffers() runs
+* unchanged. Used by the taa_bench target (compiled with TAA_HEADLESS) to time the TAA
+* chain on machines without a display or GPU (lavapipe, SwiftShader).
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "camera.hpp"
+
+class VulkanExampleBase
+{
+private:
+	// Number of offscreen images standing in for the swapchain
+	static const uint32_t imageCount = 2;
+
+	struct OffscreenImage {
+		VkImage image;
+		VkDeviceMemory mem;
+		VkImageView view;
+	};
+	std::vector<OffscreenImage> colorImages;
+
+	void createOffscreenImage(OffscreenImage &target, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect);
+	void destroyOffscreenImage(OffscreenImage &target);
+	// Fills in vulkanDevice like vks::VulkanDevice::createLogicalDevice, with deviceCreatepNextChain
+	VkResult createLogicalDevice();
+
+protected:
+	VkInstance instance;
+	VkPhysicalDevice physicalDevice;
+	VkPhysicalDeviceProperties deviceProperties;
+	VkPhysicalDeviceFeatures deviceFeatures;
+	VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+	VkPhysicalDeviceFeatures enabledFeatures{};
+	std::vector<const char*> enabledDeviceExtensions;
+	std::vector<const char*> enabledInstanceExtensions;
+	// Chained to VkDeviceCreateInfo, for features outside of VkPhysicalDeviceFeatures
+	void *deviceCreatepNextChain = nullptr;
+	VkDevice device;
+	VkQueue queue;
+	VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	VkFormat depthFormat;
+	VkCommandPool cmdPool;
+	VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkSubmitInfo submitInfo;
+	std::vector<VkCommandBuffer> drawCmdBuffers;
+	VkRenderPass renderPass;
+	std::vector<VkFramebuffer> frameBuffers;
+	uint32_t currentBuffer = 0;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkShaderModule> shaderModules;
+	VkPipelineCache pipelineCache;
+
+public:
+	bool prepared = false;
+	uint32_t width = 1280;
+	uint32_t height = 720;
+
+	float frameTimer = 1.0f;
+
+	vks::VulkanDevice *vulkanDevice;
+
+	struct Settings {
+		bool validation = false;
+		bool fullscreen = false;
+		bool vsync = false;
+		bool overlay = false;
+	} settings;
+
+	// Benchmark configuration, parsed from the command line
+	struct BenchmarkSettings {
+		uint32_t frames = 300;
+		uint32_t warmup = 10;
+		uint32_t threads = 0;
+		int32_t gpu = -1;
+		std::string output;
+	} benchmarkSettings;
+
+	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
+
+	static std::vector<const char*> args;
+
+	float timer = 0.0f;
+	float timerSpeed = 0.25f;
+	bool paused = false;
+
+	Camera camera;
+
+	std::string title = "Vulkan Example";
+	std::string name = "vulkanExample";
+
+	struct {
+		VkImage image;
+		VkDeviceMemory mem;
+		VkImageView view;
+	} depthStencil;
+
+	// Mirrors the part of VulkanSwapChain used by samples that create their own framebuffers
+	struct SwapChainBuffer {
+		VkImage image;
+		VkImageView view;
+	};
+	struct {
+		uint32_t imageCount = 0;
+		std::vector<SwapChainBuffer> buffers;
+	} swapChain;
+
+	VulkanExampleBase(bool enableValidation = false);
+	virtual ~VulkanExampleBase();
+
+	bool initVulkan();
+	virtual VkResult createInstance(bool enableValidation);
+	virtual void render() = 0;
+	virtual void viewChanged();
+	virtual void buildCommandBuffers();
+	virtual void getEnabledFeatures();
+	virtual void setupDepthStencil();
+	virtual void setupFrameBuffer();
+	virtual void setupRenderPass();
+	virtual void prepare();
+
+	void createCommandPool();
+	void setupSwapChain();
+	void createCommandBuffers();
+	void destroyCommandBuffers();
+	void createPipelineCache();
+
+	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+
+	// Renders the configured number of frames and prints the timings as JSON
+	void renderLoop();
+	// Per-pass GPU timings as a JSON object, added to the report when not empty
+	virtual std::string gpuTimingsJson(const std::string &indent);
+	// Sample specific settings and results as JSON members, added to the report when not empty
+	virtual std::string settingsJson(const std::string &indent);
+
+	// There is no UI overlay without a window
+	void drawUI(const VkCommandBuffer commandBuffer);
+
+	void prepareFrame();
+	void submitFrame();
+};
+
+// Same entry point macro as the windowed base, runs the benchmark instead of a window loop
+#define VULKAN_EXAMPLE_MAIN()																		\
+VulkanExample *vulkanExample;																		\
+int main(const int argc, const char *argv[])														\
+{																									\
+	for (int32_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };					\
+	vulkanExample = new VulkanExample();															\
+	if (!vulkanExample->initVulkan())																\
+		return 1;																					\
+	vulkanExample->prepare();																		\
+	vulkanExample->renderLoop();																	\
+	delete(vulkanExample);																			\
+	return 0;																						\
+}
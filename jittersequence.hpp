@@ -0,0 +1,137 @@
+/*
+* Subpixel jitter sequences for the TAA projection
+*
+* Every pattern is a table of offsets in [-0.5, 0.5) pixels generated at compile time
+* (Halton, R2) or baked (blue noise), selected at runtime through jitterSequence().
+* taa_jitter_bench measures how fast each one converges to a supersampled image.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum JitterPattern {
+	JITTER_HALTON_8 = 0,
+	JITTER_HALTON_16,
+	JITTER_HALTON_32,
+	JITTER_R2_16,
+	JITTER_BLUE_NOISE_16,
+	JITTER_PATTERN_COUNT
+};
+
+struct JitterSequence {
+	const char *name;
+	uint32_t count;
+	// count offsets in pixels, x then y
+	const float (*points)[2];
+};
+
+namespace jitter {
+
+template <uint32_t N>
+struct Table {
+	float points[N][2];
+};
+
+// Radical inverse of index in the given base
+constexpr float halton(uint32_t base, uint32_t index)
+{
+	float f = 1.0f;
+	float r = 0.0f;
+	while (index > 0)
+	{
+		f /= base;
+		r += f * (index % base);
+		index /= base;
+	}
+	return r;
+}
+
+// Halton(2, 3) from index 1, index 0 would put the first sample on the pixel corner
+template <uint32_t N>
+constexpr Table<N> makeHalton()
+{
+	Table<N> table = {};
+	for (uint32_t i = 0; i < N; i++)
+	{
+		table.points[i][0] = halton(2, i + 1) - 0.5f;
+		table.points[i][1] = halton(3, i + 1) - 0.5f;
+	}
+	return table;
+}
+
+constexpr double fract(double v)
+{
+	return v - static_cast<double>(static_cast<int64_t>(v));
+}
+
+// R2 (Roberts 2018): additive recurrence on the inverse powers of the plastic number
+template <uint32_t N>
+constexpr Table<N> makeR2()
+{
+	Table<N> table = {};
+	for (uint32_t i = 0; i < N; i++)
+	{
+		table.points[i][0] = static_cast<float>(fract(0.5 + 0.7548776662466927 * (i + 1)) - 0.5);
+		table.points[i][1] = static_cast<float>(fract(0.5 + 0.5698402909980532 * (i + 1)) - 0.5);
+	}
+	return table;
+}
+
+constexpr Table<8> halton8 = makeHalton<8>();
+constexpr Table<16> halton16 = makeHalton<16>();
+constexpr Table<32> halton32 = makeHalton<32>();
+constexpr Table<16> r2x16 = makeR2<16>();
+
+// Mitchell's best candidate on the torus (10 candidates per placed point), so every
+// prefix of the sequence is spread out as well
+constexpr Table<16> blueNoise16 = { {
+	{ 0.078931f, -0.068014f },
+	{ -0.407955f, -0.351285f },
+	{ -0.417686f, 0.109920f },
+	{ 0.189758f, 0.350073f },
+	{ -0.127217f, 0.377533f },
+	{ 0.397453f, -0.148912f },
+	{ 0.172905f, -0.329429f },
+	{ -0.129969f, 0.106451f },
+	{ 0.271737f, 0.102161f },
+	{ -0.115490f, -0.300351f },
+	{ -0.371228f, 0.404108f },
+	{ -0.331335f, -0.121623f },
+	{ 0.428484f, 0.282937f },
+	{ 0.407350f, 0.496556f },
+	{ 0.077376f, 0.186769f },
+	{ -0.123113f, -0.096892f }
+} };
+
+static_assert(halton16.points[0][0] == 0.0f && halton16.points[0][1] == 1.0f / 3.0f - 0.5f, "Halton(2, 3) starts at index 1");
+
+} // namespace jitter
+
+inline JitterSequence jitterSequence(JitterPattern pattern)
+{
+	switch (pattern) {
+	case JITTER_HALTON_8: return { "halton8", 8, jitter::halton8.points };
+	case JITTER_HALTON_32: return { "halton32", 32, jitter::halton32.points };
+	case JITTER_R2_16: return { "r2", 16, jitter::r2x16.points };
+	case JITTER_BLUE_NOISE_16: return { "bluenoise", 16, jitter::blueNoise16.points };
+	default: return { "halton16", 16, jitter::halton16.points };
+	}
+}
+
+// Accepts the names returned in JitterSequence::name
+inline bool jitterPatternFromName(const std::string &name, JitterPattern &pattern)
+{
+	for (int p = 0; p < JITTER_PATTERN_COUNT; p++)
+	{
+		if (name == jitterSequence(static_cast<JitterPattern>(p)).name)
+		{
+			pattern = static_cast<JitterPattern>(p);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,671 @@
+/*
+* Preprocessed binary meshes
+*
+* taa_meshconvert imports a model once with Assimp (MeshFile::import, the conventions of
+* vks::Model::loadFromFile), reorders it with MeshFile::optimize and writes one or more
+* vertex streams and the 32 bit indices as blobs. At runtime MeshFile::map memory maps the
+* file and hands out pointers into the mapping, which are copied straight into the staging
+* buffers: no parsing and no intermediate copies.
+*
+* Every stream interleaves its own components, so passes that only need positions can fetch
+* a stream holding nothing else. Normals may be stored octahedral encoded in two snorm16 and
+* UVs as two half floats.
+*
+* Layout, little endian:
+*   Header        see below, the offsets count from the start of the file
+*   streams       vertexCount * stride bytes each, components interleaved in layout order
+*   indices       indexCount uint32, triangle lists
+* Every blob starts on a 16 byte boundary.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+class MeshFile
+{
+public:
+	enum Component : uint32_t {
+		// Three floats
+		COMPONENT_POSITION = 0,
+		COMPONENT_NORMAL,
+		// Two floats
+		COMPONENT_UV,
+		// Two snorm16, octahedral encoding of the unit normal
+		COMPONENT_NORMAL_OCT,
+		// Two half floats
+		COMPONENT_UV_HALF
+	};
+	static const uint32_t MAX_COMPONENTS = 8;
+	static const uint32_t MAX_STREAMS = 4;
+
+	typedef std::vector<Component> Layout;
+
+	struct StreamHeader {
+		uint32_t componentCount;
+		uint32_t components[MAX_COMPONENTS];
+		// In bytes
+		uint32_t stride;
+		uint64_t offset;
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t streamCount;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t reserved;
+		uint64_t indexOffset;
+		StreamHeader streams[MAX_STREAMS];
+	};
+
+	struct Stream {
+		Layout layout;
+		std::vector<uint8_t> bytes;
+	};
+
+	// An imported model, what the file holds
+	struct Data {
+		std::vector<Stream> streams;
+		std::vector<uint32_t> indices;
+		uint32_t vertexCount = 0;
+	};
+
+private:
+	// Eight bytes with the terminator
+	static const char *magic()
+	{
+		return "TAAMSH2";
+	}
+
+	static uint64_t alignUp(uint64_t value)
+	{
+		return (value + 15) & ~static_cast<uint64_t>(15);
+	}
+
+	Header fileHeader = {};
+	const uint8_t *mapping = nullptr;
+	size_t mappingSize = 0;
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE fileMapping = nullptr;
+#endif
+
+	bool valid() const
+	{
+		if (mappingSize < sizeof(Header) || memcmp(fileHeader.magic, magic(), sizeof(fileHeader.magic)) != 0)
+			return false;
+		if (fileHeader.streamCount == 0 || fileHeader.streamCount > MAX_STREAMS)
+			return false;
+		// Blobs in file order, each behind the previous one
+		uint64_t end = sizeof(Header);
+		for (uint32_t s = 0; s < fileHeader.streamCount; s++)
+		{
+			const StreamHeader &stream = fileHeader.streams[s];
+			if (stream.componentCount == 0 || stream.componentCount > MAX_COMPONENTS)
+				return false;
+			uint32_t bytes = 0;
+			for (uint32_t c = 0; c < stream.componentCount; c++)
+			{
+				if (stream.components[c] > COMPONENT_UV_HALF)
+					return false;
+				bytes += componentBytes(static_cast<Component>(stream.components[c]));
+			}
+			const uint64_t streamBytes = static_cast<uint64_t>(fileHeader.vertexCount) * stream.stride;
+			if (stream.stride != bytes || stream.offset < end || stream.offset > mappingSize || streamBytes > mappingSize - stream.offset)
+				return false;
+			end = stream.offset + streamBytes;
+		}
+		const uint64_t indexBytes = static_cast<uint64_t>(fileHeader.indexCount) * sizeof(uint32_t);
+		if (fileHeader.indexOffset < end || fileHeader.indexOffset > mappingSize || indexBytes > mappingSize - fileHeader.indexOffset)
+			return false;
+		// Every index once, an index past the vertices would make the GPU fetch outside of the
+		// vertex buffers
+		const uint8_t *indexData = mapping + fileHeader.indexOffset;
+		uint32_t maxIndex = 0;
+		for (uint32_t i = 0; i < fileHeader.indexCount; i++)
+		{
+			uint32_t index;
+			memcpy(&index, indexData + static_cast<size_t>(i) * sizeof(uint32_t), sizeof(index));
+			maxIndex = std::max(maxIndex, index);
+		}
+		return fileHeader.indexCount == 0 || maxIndex < fileHeader.vertexCount;
+	}
+
+	// Whether dropping the low shift bits rounds up, to nearest even
+	static uint32_t roundsUp(uint32_t mantissa, uint32_t shift)
+	{
+		const uint32_t rest = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		return (rest > halfway || (rest == halfway && ((mantissa >> shift) & 1))) ? 1 : 0;
+	}
+
+	// Round to nearest even, overflow to infinity, small values to denormals or zero
+	static uint16_t toHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t biased = (bits >> 23) & 0xff;
+		uint32_t mantissa = bits & 0x7fffff;
+		if (biased == 0xff)
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+		const int32_t exponent = static_cast<int32_t>(biased) - 127 + 15;
+		if (exponent >= 31)
+			return static_cast<uint16_t>(sign | 0x7c00);
+		if (exponent <= 0) {
+			if (exponent < -10)
+				return static_cast<uint16_t>(sign);
+			mantissa |= 0x800000;
+			const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			return static_cast<uint16_t>(sign | ((mantissa >> shift) + roundsUp(mantissa, shift)));
+		}
+		// A carry out of the mantissa rounds up into the exponent
+		return static_cast<uint16_t>((sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13)) + roundsUp(mantissa, 13));
+	}
+
+	static int16_t toSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::round(std::max(-1.0f, std::min(value, 1.0f)) * 32767.0f));
+	}
+
+	// Projects the unit normal onto the octahedron and unfolds the lower half over the corners
+	static void octEncode(float x, float y, float z, int16_t encoded[2])
+	{
+		const float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+		float u = (length > 0.0f) ? x / length : 0.0f;
+		float v = (length > 0.0f) ? y / length : 0.0f;
+		if (z < 0.0f) {
+			const float folded[2] = { (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f) };
+			u = folded[0];
+			v = folded[1];
+		}
+		encoded[0] = toSnorm16(u);
+		encoded[1] = toSnorm16(v);
+	}
+
+	static void append(std::vector<uint8_t> &bytes, const void *data, size_t size)
+	{
+		const uint8_t *source = static_cast<const uint8_t*>(data);
+		bytes.insert(bytes.end(), source, source + size);
+	}
+
+	// Transformed vertices with a FIFO cache of cacheSize entries, the usual model of
+	// post-transform caches
+	static uint32_t cacheMisses(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		std::vector<uint32_t> insertedAt(vertexCount, 0);
+		uint32_t misses = 0;
+		for (uint32_t index : indices)
+		{
+			// insertedAt is one based, 0 is never cached
+			if (insertedAt[index] == 0 || misses + 1 - insertedAt[index] > cacheSize) {
+				misses++;
+				insertedAt[index] = misses;
+			}
+		}
+		return misses;
+	}
+
+public:
+	MeshFile() = default;
+	MeshFile(const MeshFile &) = delete;
+	MeshFile &operator=(const MeshFile &) = delete;
+
+	~MeshFile()
+	{
+		unmap();
+	}
+
+	static uint32_t componentBytes(Component component)
+	{
+		switch (component) {
+		case COMPONENT_POSITION:
+		case COMPONENT_NORMAL:
+			return 3 * sizeof(float);
+		case COMPONENT_UV:
+			return 2 * sizeof(float);
+		default:
+			return 2 * sizeof(uint16_t);
+		}
+	}
+
+	// Streams scenerendering draws from: positions alone for the velocity pass and the vertex
+	// animation pre-pass, packed normals and UVs on top for the building pass
+	static std::vector<Layout> sceneStreams()
+	{
+		return { { COMPONENT_POSITION }, { COMPONENT_NORMAL_OCT, COMPONENT_UV_HALF } };
+	}
+
+	// In bytes
+	static uint32_t stride(const Layout &layout)
+	{
+		uint32_t bytes = 0;
+		for (auto component : layout)
+			bytes += componentBytes(component);
+		return bytes;
+	}
+
+	// Assimp import with the flags and vertex conventions of vks::Model::loadFromFile, one
+	// stream per layout
+	static bool import(const std::string &path, const std::vector<Layout> &layouts, Data &data, std::string &error)
+	{
+		if (layouts.empty() || layouts.size() > MAX_STREAMS) {
+			error = "unsupported number of vertex streams";
+			return false;
+		}
+
+		Assimp::Importer importer;
+		const aiScene *scene = importer.ReadFile(path.c_str(), aiProcess_FlipWindingOrder | aiProcess_Triangulate | aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals);
+		if (scene == nullptr) {
+			error = importer.GetErrorString();
+			return false;
+		}
+
+		data = Data();
+		data.streams.resize(layouts.size());
+		for (size_t s = 0; s < layouts.size(); s++)
+			data.streams[s].layout = layouts[s];
+		const aiVector3D zero(0.0f, 0.0f, 0.0f);
+		for (uint32_t m = 0; m < scene->mNumMeshes; m++)
+		{
+			const aiMesh *part = scene->mMeshes[m];
+			const uint32_t indexBase = data.vertexCount;
+			for (uint32_t v = 0; v < part->mNumVertices; v++)
+			{
+				const aiVector3D &pos = part->mVertices[v];
+				const aiVector3D &normal = part->HasNormals() ? part->mNormals[v] : zero;
+				const aiVector3D &uv = part->HasTextureCoords(0) ? part->mTextureCoords[0][v] : zero;
+				for (auto &stream : data.streams)
+				{
+					for (auto component : stream.layout)
+					{
+						switch (component) {
+						case COMPONENT_POSITION: {
+							const float values[3] = { pos.x, -pos.y, pos.z };
+							append(stream.bytes, values, sizeof(values));
+							break;
+						}
+						case COMPONENT_NORMAL: {
+							const float values[3] = { normal.x, -normal.y, normal.z };
+							append(stream.bytes, values, sizeof(values));
+							break;
+						}
+						case COMPONENT_UV: {
+							const float values[2] = { uv.x, uv.y };
+							append(stream.bytes, values, sizeof(values));
+							break;
+						}
+						case COMPONENT_NORMAL_OCT: {
+							int16_t values[2];
+							octEncode(normal.x, -normal.y, normal.z, values);
+							append(stream.bytes, values, sizeof(values));
+							break;
+						}
+						case COMPONENT_UV_HALF: {
+							const uint16_t values[2] = { toHalf(uv.x), toHalf(uv.y) };
+							append(stream.bytes, values, sizeof(values));
+							break;
+						}
+						}
+					}
+				}
+			}
+			data.vertexCount += part->mNumVertices;
+			for (uint32_t f = 0; f < part->mNumFaces; f++)
+			{
+				const aiFace &face = part->mFaces[f];
+				if (face.mNumIndices != 3)
+					continue;
+				data.indices.insert(data.indices.end(), { indexBase + face.mIndices[0], indexBase + face.mIndices[1], indexBase + face.mIndices[2] });
+			}
+		}
+		return true;
+	}
+
+	// Average cache miss ratio, transformed vertices per triangle with a FIFO cache of
+	// cacheSize entries. 0.5 is the lower bound on closed meshes, 3 means no reuse.
+	static float acmr(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize = 16)
+	{
+		if (indices.size() < 3)
+			return 0.0f;
+		return static_cast<float>(cacheMisses(indices, vertexCount, cacheSize)) / static_cast<float>(indices.size() / 3);
+	}
+
+	// Reorders the triangles for the post-transform vertex cache (Forsyth, "Linear-speed vertex
+	// cache optimisation"), then the vertices in the order the triangles first use them, so
+	// vertex fetch walks the streams front to back
+	static void optimize(Data &data)
+	{
+		const uint32_t cacheSize = 32;
+		const uint32_t vertexCount = data.vertexCount;
+		const size_t triangleCount = data.indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+		std::vector<uint32_t> &indices = data.indices;
+		indices.resize(triangleCount * 3);
+
+		// Triangles of every vertex, the first remaining[v] entries of its range are not emitted yet
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (uint32_t index : indices)
+			remaining[index]++;
+		std::vector<uint32_t> first(vertexCount + 1, 0);
+		for (uint32_t v = 0; v < vertexCount; v++)
+			first[v + 1] = first[v] + remaining[v];
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+		}
+
+		std::vector<int32_t> cachePosition(vertexCount, -1);
+		auto vertexScore = [&](uint32_t v) {
+			if (remaining[v] == 0)
+				return -1.0f;
+			float score = 0.0f;
+			const int32_t position = cachePosition[v];
+			if (position >= 0) {
+				// The last triangle's vertices get a fixed score, they should not be reused right away
+				score = (position < 3) ? 0.75f : std::pow(1.0f - static_cast<float>(position - 3) / static_cast<float>(cacheSize - 3), 1.5f);
+			}
+			// Vertices with few triangles left are finished first
+			return score + 2.0f / std::sqrt(static_cast<float>(remaining[v]));
+		};
+		std::vector<float> scores(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++)
+			scores[v] = vertexScore(v);
+		auto triangleScore = [&](uint32_t t) {
+			return scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+		};
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> order;
+		order.reserve(indices.size());
+		std::vector<uint32_t> cache, nextCache;
+		// Step in which a vertex was last put into nextCache, instead of searching it
+		std::vector<uint32_t> added(vertexCount, 0);
+		uint32_t step = 0;
+		size_t cursor = 0;
+		int64_t best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			const float score = triangleScore(t);
+			if (score > bestScore) {
+				bestScore = score;
+				best = t;
+			}
+		}
+		while (order.size() < indices.size())
+		{
+			// Nothing in the cache has triangles left, continue with the next one in input order
+			if (best < 0) {
+				while (emitted[cursor])
+					cursor++;
+				best = static_cast<int64_t>(cursor);
+			}
+			const uint32_t triangle = static_cast<uint32_t>(best);
+			emitted[triangle] = true;
+			nextCache.clear();
+			step++;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const uint32_t v = indices[triangle * 3 + k];
+				order.push_back(v);
+				uint32_t *list = &adjacency[first[v]];
+				for (uint32_t a = 0; a < remaining[v]; a++)
+				{
+					if (list[a] == triangle) {
+						std::swap(list[a], list[remaining[v] - 1]);
+						break;
+					}
+				}
+				remaining[v]--;
+				if (added[v] != step) {
+					added[v] = step;
+					nextCache.push_back(v);
+				}
+			}
+			for (uint32_t v : cache)
+			{
+				if (added[v] != step) {
+					added[v] = step;
+					nextCache.push_back(v);
+				}
+			}
+			// Vertices pushed out of the cache are rescored as well
+			for (uint32_t c = 0; c < nextCache.size(); c++)
+			{
+				const uint32_t v = nextCache[c];
+				cachePosition[v] = (c < cacheSize) ? static_cast<int32_t>(c) : -1;
+				scores[v] = vertexScore(v);
+			}
+			best = -1;
+			bestScore = -1.0f;
+			for (uint32_t v : nextCache)
+			{
+				for (uint32_t a = 0; a < remaining[v]; a++)
+				{
+					const uint32_t t = adjacency[first[v] + a];
+					const float score = triangleScore(t);
+					if (score > bestScore) {
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+			nextCache.resize(std::min<size_t>(nextCache.size(), cacheSize));
+			std::swap(cache, nextCache);
+		}
+
+		// New vertex index in order of first use, unused vertices go last
+		const uint32_t unused = ~0u;
+		std::vector<uint32_t> remap(vertexCount, unused);
+		uint32_t next = 0;
+		for (uint32_t &index : order)
+		{
+			if (remap[index] == unused)
+				remap[index] = next++;
+			index = remap[index];
+		}
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			if (remap[v] == unused)
+				remap[v] = next++;
+		}
+		indices.swap(order);
+		for (auto &stream : data.streams)
+		{
+			const uint32_t bytes = stride(stream.layout);
+			std::vector<uint8_t> reordered(stream.bytes.size());
+			for (uint32_t v = 0; v < vertexCount; v++)
+				memcpy(&reordered[static_cast<size_t>(remap[v]) * bytes], &stream.bytes[static_cast<size_t>(v) * bytes], bytes);
+			stream.bytes.swap(reordered);
+		}
+	}
+
+	static bool write(const std::string &path, const Data &data)
+	{
+		if (data.streams.empty() || data.streams.size() > MAX_STREAMS)
+			return false;
+		Header header = {};
+		memcpy(header.magic, magic(), sizeof(header.magic));
+		header.streamCount = static_cast<uint32_t>(data.streams.size());
+		header.vertexCount = data.vertexCount;
+		header.indexCount = static_cast<uint32_t>(data.indices.size());
+		uint64_t offset = alignUp(sizeof(Header));
+		for (size_t s = 0; s < data.streams.size(); s++)
+		{
+			const Stream &stream = data.streams[s];
+			if (stream.layout.empty() || stream.layout.size() > MAX_COMPONENTS)
+				return false;
+			StreamHeader &streamHeader = header.streams[s];
+			streamHeader.componentCount = static_cast<uint32_t>(stream.layout.size());
+			for (size_t c = 0; c < stream.layout.size(); c++)
+				streamHeader.components[c] = stream.layout[c];
+			streamHeader.stride = stride(stream.layout);
+			streamHeader.offset = offset;
+			offset = alignUp(offset + stream.bytes.size());
+		}
+		header.indexOffset = offset;
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		const char padding[16] = {};
+		uint64_t written = sizeof(header);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (size_t s = 0; s < data.streams.size(); s++)
+		{
+			file.write(padding, header.streams[s].offset - written);
+			file.write(reinterpret_cast<const char*>(data.streams[s].bytes.data()), data.streams[s].bytes.size());
+			written = header.streams[s].offset + data.streams[s].bytes.size();
+		}
+		file.write(padding, header.indexOffset - written);
+		file.write(reinterpret_cast<const char*>(data.indices.data()), data.indices.size() * sizeof(uint32_t));
+		return file.good();
+	}
+
+	// Maps the whole file read only, the pointers below stay valid until unmap()
+	bool map(const std::string &path, std::string &error)
+	{
+		unmap();
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER size;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+			error = "could not open the file";
+			unmap();
+			return false;
+		}
+		mappingSize = static_cast<size_t>(size.QuadPart);
+		fileMapping = (mappingSize > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		mapping = fileMapping ? static_cast<const uint8_t*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat status;
+		if (fd < 0 || fstat(fd, &status) != 0) {
+			error = "could not open the file";
+			if (fd >= 0)
+				close(fd);
+			return false;
+		}
+		mappingSize = static_cast<size_t>(status.st_size);
+		void *address = (mappingSize > 0) ? mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		// The mapping keeps its own reference to the file
+		close(fd);
+		mapping = (address != MAP_FAILED) ? static_cast<const uint8_t*>(address) : nullptr;
+		if (mapping != nullptr)
+			madvise(address, mappingSize, MADV_SEQUENTIAL);
+#endif
+		if (mapping == nullptr) {
+			error = "could not map the file";
+			unmap();
+			return false;
+		}
+		memcpy(&fileHeader, mapping, std::min(mappingSize, sizeof(Header)));
+		if (!valid()) {
+			error = "not a mesh file of this version, truncated or with indices past the vertices";
+			unmap();
+			return false;
+		}
+		return true;
+	}
+
+	void unmap()
+	{
+#if defined(_WIN32)
+		if (mapping != nullptr)
+			UnmapViewOfFile(mapping);
+		if (fileMapping != nullptr)
+			CloseHandle(fileMapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		fileMapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (mapping != nullptr)
+			munmap(const_cast<uint8_t*>(mapping), mappingSize);
+#endif
+		mapping = nullptr;
+		mappingSize = 0;
+		fileHeader = {};
+	}
+
+	// Whether the file holds exactly these streams
+	bool matches(const std::vector<Layout> &layouts) const
+	{
+		if (layouts.size() != fileHeader.streamCount)
+			return false;
+		for (size_t s = 0; s < layouts.size(); s++)
+		{
+			const StreamHeader &stream = fileHeader.streams[s];
+			if (layouts[s].size() != stream.componentCount)
+				return false;
+			for (size_t c = 0; c < layouts[s].size(); c++)
+			{
+				if (stream.components[c] != layouts[s][c])
+					return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t streamCount() const
+	{
+		return fileHeader.streamCount;
+	}
+
+	uint32_t vertexCount() const
+	{
+		return fileHeader.vertexCount;
+	}
+
+	uint32_t indexCount() const
+	{
+		return fileHeader.indexCount;
+	}
+
+	const void *vertices(uint32_t stream) const
+	{
+		return mapping + fileHeader.streams[stream].offset;
+	}
+
+	size_t vertexBytes(uint32_t stream) const
+	{
+		return static_cast<size_t>(fileHeader.vertexCount) * fileHeader.streams[stream].stride;
+	}
+
+	const void *indices() const
+	{
+		return mapping + fileHeader.indexOffset;
+	}
+
+	size_t indexBytes() const
+	{
+		return static_cast<size_t>(fileHeader.indexCount) * sizeof(uint32_t);
+	}
+};
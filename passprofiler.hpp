@@ -0,0 +1,292 @@
+/*
+* Per-pass GPU timestamp profiler
+*
+* Every pre-recorded command buffer owns a slot in a single timestamp query pool with a
+* begin/end query pair per pass. Results are polled without VK_QUERY_RESULT_WAIT_BIT after
+* submission, so reading them back never stalls the frame. Durations are kept in a rolling
+* window per pass for min/avg/p95/p99 statistics.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.h"
+#include "VulkanDevice.hpp"
+
+class PassProfiler
+{
+public:
+	struct Stats {
+		uint32_t samples = 0;
+		float last = 0.0f;
+		float min = 0.0f;
+		float avg = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+	};
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	float timestampPeriod = 1.0f;
+	uint64_t timestampMask = ~0ULL;
+	uint32_t slotCount = 0;
+	uint32_t windowSize = 256;
+	std::vector<std::string> passNames;
+
+	// Passes recorded into each slot and whether a submission is waiting for its results
+	std::vector<uint32_t> recordedPasses;
+	// Passes recorded on a queue without timestamps, never timed
+	uint32_t untimedPasses = 0;
+	std::vector<bool> pending;
+
+	// Rolling window of durations in milliseconds, per pass
+	std::vector<std::vector<float>> history;
+	std::vector<uint32_t> historyHead;
+	uint32_t droppedFrames = 0;
+
+	// Sum of the pass durations of the latest collected submission
+	uint32_t frames = 0;
+	float frameMs = 0.0f;
+
+	uint32_t firstQuery(uint32_t slot, uint32_t pass) const
+	{
+		return (slot * static_cast<uint32_t>(passNames.size()) + pass) * 2;
+	}
+
+	static float percentile(std::vector<float> &sorted, float p)
+	{
+		size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5f);
+		return sorted[index];
+	}
+
+public:
+	bool enabled = false;
+
+	// Timestamps need support on the graphics queue, the profiler stays disabled otherwise
+	void prepare(vks::VulkanDevice *vulkanDevice, const std::vector<std::string> &names, uint32_t slots, uint32_t window = 256)
+	{
+		destroy();
+		device = vulkanDevice->logicalDevice;
+		passNames = names;
+		slotCount = slots;
+		windowSize = window;
+
+		uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		if (validBits == 0 || vulkanDevice->properties.limits.timestampPeriod == 0.0f)
+		{
+			enabled = false;
+			return;
+		}
+		timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+		timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = slotCount * static_cast<uint32_t>(passNames.size()) * 2;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+
+		recordedPasses.assign(slotCount, 0);
+		pending.assign(slotCount, false);
+		history.assign(passNames.size(), std::vector<float>());
+		historyHead.assign(passNames.size(), 0);
+		untimedPasses = 0;
+		enabled = true;
+	}
+
+	// For passes on a queue whose family has no timestampValidBits, call after prepare()
+	void exclude(uint32_t pass)
+	{
+		untimedPasses |= (1u << pass);
+	}
+
+	void destroy()
+	{
+		if (queryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, queryPool, nullptr);
+			queryPool = VK_NULL_HANDLE;
+		}
+		enabled = false;
+	}
+
+	const std::vector<std::string> &names() const
+	{
+		return passNames;
+	}
+
+	// Record at the start of a command buffer, outside of any render pass
+	void reset(VkCommandBuffer cmdBuffer, uint32_t slot)
+	{
+		if (!enabled)
+			return;
+		recordedPasses[slot] = 0;
+		vkCmdResetQueryPool(cmdBuffer, queryPool, firstQuery(slot, 0), static_cast<uint32_t>(passNames.size()) * 2);
+	}
+
+	void begin(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t pass)
+	{
+		if (!enabled || (untimedPasses & (1u << pass)))
+			return;
+		recordedPasses[slot] |= (1u << pass);
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery(slot, pass));
+	}
+
+	void end(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t pass)
+	{
+		if (!enabled || (untimedPasses & (1u << pass)))
+			return;
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery(slot, pass) + 1);
+	}
+
+	// Call right before the command buffer owning the slot is submitted
+	void submitted(uint32_t slot)
+	{
+		if (!enabled)
+			return;
+		// Results that were never picked up are overwritten by this submission
+		if (pending[slot])
+			droppedFrames++;
+		pending[slot] = true;
+	}
+
+	// Picks up finished results of earlier submissions, never waits for the GPU
+	void collect()
+	{
+		if (!enabled)
+			return;
+		const uint32_t passCount = static_cast<uint32_t>(passNames.size());
+		// Value and availability for each query
+		std::vector<uint64_t> results(passCount * 2 * 2);
+		for (uint32_t slot = 0; slot < slotCount; slot++)
+		{
+			if (!pending[slot])
+				continue;
+			VkResult res = vkGetQueryPoolResults(
+				device,
+				queryPool,
+				firstQuery(slot, 0),
+				passCount * 2,
+				results.size() * sizeof(uint64_t),
+				results.data(),
+				2 * sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if (res != VK_SUCCESS && res != VK_NOT_READY)
+			{
+				VK_CHECK_RESULT(res);
+			}
+
+			bool available = true;
+			for (uint32_t pass = 0; pass < passCount; pass++)
+			{
+				if ((recordedPasses[slot] & (1u << pass)) == 0)
+					continue;
+				available &= (results[pass * 4 + 1] != 0) && (results[pass * 4 + 3] != 0);
+			}
+			if (!available)
+				continue;
+
+			float sum = 0.0f;
+			for (uint32_t pass = 0; pass < passCount; pass++)
+			{
+				if ((recordedPasses[slot] & (1u << pass)) == 0)
+					continue;
+				uint64_t ticks = ((results[pass * 4 + 2] & timestampMask) - (results[pass * 4] & timestampMask)) & timestampMask;
+				float ms = static_cast<float>(static_cast<double>(ticks) * timestampPeriod / 1000000.0);
+				if (history[pass].size() < windowSize)
+				{
+					history[pass].push_back(ms);
+				}
+				else
+				{
+					history[pass][historyHead[pass]] = ms;
+				}
+				historyHead[pass] = (historyHead[pass] + 1) % windowSize;
+				sum += ms;
+			}
+			frameMs = sum;
+			frames++;
+			pending[slot] = false;
+		}
+	}
+
+	// Number of submissions collected so far, changes when lastFrameMs() does
+	uint32_t collectedFrames() const
+	{
+		return frames;
+	}
+
+	float lastFrameMs() const
+	{
+		return frameMs;
+	}
+
+	Stats stats(uint32_t pass) const
+	{
+		Stats stats;
+		if (pass >= history.size() || history[pass].empty())
+			return stats;
+		std::vector<float> sorted = history[pass];
+		std::sort(sorted.begin(), sorted.end());
+		float sum = 0.0f;
+		for (auto ms : sorted)
+		{
+			sum += ms;
+		}
+		stats.samples = static_cast<uint32_t>(sorted.size());
+		stats.last = history[pass][(historyHead[pass] + history[pass].size() - 1) % history[pass].size()];
+		stats.min = sorted.front();
+		stats.avg = sum / sorted.size();
+		stats.p95 = percentile(sorted, 0.95f);
+		stats.p99 = percentile(sorted, 0.99f);
+		return stats;
+	}
+
+	std::string csv() const
+	{
+		std::stringstream ss;
+		ss << "pass,samples,last_ms,min_ms,avg_ms,p95_ms,p99_ms\n";
+		for (uint32_t pass = 0; pass < passNames.size(); pass++)
+		{
+			Stats s = stats(pass);
+			ss << passNames[pass] << "," << s.samples << "," << s.last << "," << s.min << "," << s.avg << "," << s.p95 << "," << s.p99 << "\n";
+		}
+		return ss.str();
+	}
+
+	// JSON object keyed by pass name
+	std::string json(const std::string &indent = "") const
+	{
+		std::stringstream ss;
+		ss << "{\n";
+		for (uint32_t pass = 0; pass < passNames.size(); pass++)
+		{
+			Stats s = stats(pass);
+			ss << indent << "\t\"" << passNames[pass] << "\": { "
+				<< "\"samples\": " << s.samples << ", "
+				<< "\"minMs\": " << s.min << ", "
+				<< "\"avgMs\": " << s.avg << ", "
+				<< "\"p95Ms\": " << s.p95 << ", "
+				<< "\"p99Ms\": " << s.p99 << " }"
+				<< ",\n";
+		}
+		ss << indent << "\t\"droppedFrames\": " << droppedFrames << "\n";
+		ss << indent << "}";
+		return ss.str();
+	}
+
+	void dump(const std::string &csvFile, const std::string &jsonFile) const
+	{
+		std::ofstream(csvFile) << csv();
+		std::ofstream(jsonFile) << json() << "\n";
+	}
+};
@@ -0,0 +1,325 @@
+/*
+* Persistent pipeline cache and parallel pipeline creation
+*
+* PipelineCacheFile keeps the VkPipelineCache data on disk between runs, one file per
+* pipeline cache UUID and driver version. The data is checked against the running device
+* before it is passed to vkCreatePipelineCache, a stale, foreign or truncated file starts
+* an empty cache instead. PipelineBatch collects pipeline create infos and creates them on
+* worker threads, all sharing one cache (the implementation synchronizes access to it).
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.h"
+
+class PipelineCacheFile
+{
+public:
+	enum Status {
+		STATUS_DISABLED = 0,
+		STATUS_MISSING,
+		STATUS_INVALID,
+		STATUS_LOADED
+	};
+
+private:
+	// Written in front of the driver's data, its own header has no driver version or size check
+	struct FileHeader {
+		char magic[8];
+		uint32_t driverVersion;
+		uint32_t dataSize;
+		uint64_t checksum;
+	};
+	// Eight bytes with the terminator
+	static const char *magic()
+	{
+		return "TAAPSO1";
+	}
+
+	// Layout of VkPipelineCacheHeaderVersionOne
+	static const size_t VK_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+	std::string path;
+	VkPhysicalDeviceProperties properties = {};
+	Status state = STATUS_DISABLED;
+	size_t loadedBytes = 0;
+
+	// FNV-1a
+	static uint64_t checksum(const uint8_t *data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	bool valid(const FileHeader &header, const std::vector<uint8_t> &data) const
+	{
+		if (memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.driverVersion != properties.driverVersion)
+			return false;
+		if (header.dataSize != data.size() || data.size() < VK_HEADER_SIZE || header.checksum != checksum(data.data(), data.size()))
+			return false;
+		uint32_t vkHeader[4];
+		memcpy(vkHeader, data.data(), sizeof(vkHeader));
+		return vkHeader[0] >= VK_HEADER_SIZE
+			&& vkHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& vkHeader[2] == properties.vendorID
+			&& vkHeader[3] == properties.deviceID
+			&& memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+public:
+	// File name in the working directory, keyed by the cache UUID and the driver version
+	static std::string defaultPath(const VkPhysicalDeviceProperties &properties)
+	{
+		std::stringstream ss;
+		ss << "pipelinecache_";
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+		{
+			const char *digits = "0123456789abcdef";
+			ss << digits[properties.pipelineCacheUUID[i] >> 4] << digits[properties.pipelineCacheUUID[i] & 0xf];
+		}
+		ss << "_" << properties.driverVersion << ".bin";
+		return ss.str();
+	}
+
+	static std::vector<uint8_t> data(VkDevice device, VkPipelineCache cache)
+	{
+		size_t size = 0;
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, nullptr));
+		std::vector<uint8_t> data(size);
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, data.data()));
+		data.resize(size);
+		return data;
+	}
+
+	static VkPipelineCache create(VkDevice device, const std::vector<uint8_t> &initialData)
+	{
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = initialData.size();
+		pipelineCacheCreateInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+		VkPipelineCache cache;
+		VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache));
+		return cache;
+	}
+
+	// Creates a cache with the contents of filePath, or an empty one if it does not match the device
+	VkPipelineCache load(VkDevice device, const VkPhysicalDeviceProperties &deviceProperties, const std::string &filePath)
+	{
+		path = filePath;
+		properties = deviceProperties;
+		loadedBytes = 0;
+		std::vector<uint8_t> initialData;
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+		{
+			state = STATUS_MISSING;
+			return create(device, initialData);
+		}
+		FileHeader header = {};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (file.gcount() == sizeof(header) && header.dataSize > 0)
+		{
+			initialData.resize(header.dataSize);
+			file.read(reinterpret_cast<char*>(initialData.data()), initialData.size());
+			initialData.resize(static_cast<size_t>(file.gcount()));
+		}
+		if (!valid(header, initialData))
+		{
+			state = STATUS_INVALID;
+			initialData.clear();
+			return create(device, initialData);
+		}
+		state = STATUS_LOADED;
+		loadedBytes = initialData.size();
+		return create(device, initialData);
+	}
+
+	// Writes a temporary file first, an interrupted run never leaves a truncated cache behind
+	void save(VkDevice device, VkPipelineCache cache)
+	{
+		if (state == STATUS_DISABLED)
+			return;
+		const std::vector<uint8_t> cacheData = data(device, cache);
+		FileHeader header = {};
+		memcpy(header.magic, magic(), sizeof(header.magic));
+		header.driverVersion = properties.driverVersion;
+		header.dataSize = static_cast<uint32_t>(cacheData.size());
+		header.checksum = checksum(cacheData.data(), cacheData.size());
+
+		const std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cerr << "Could not write pipeline cache " << tempPath << std::endl;
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(cacheData.data()), cacheData.size());
+		}
+		std::remove(path.c_str());
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+		{
+			std::cerr << "Could not write pipeline cache " << path << std::endl;
+		}
+	}
+
+	Status status() const
+	{
+		return state;
+	}
+
+	size_t loadedSize() const
+	{
+		return loadedBytes;
+	}
+
+	static const char *statusName(Status status)
+	{
+		switch (status) {
+		case STATUS_MISSING: return "missing";
+		case STATUS_INVALID: return "invalid";
+		case STATUS_LOADED: return "loaded";
+		default: return "disabled";
+		}
+	}
+};
+
+class PipelineBatch
+{
+private:
+	// Copy of a stage's specialization info, the caller's is often a loop local
+	struct Specialization {
+		VkSpecializationInfo info;
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint8_t> data;
+	};
+
+	struct Entry {
+		bool compute = false;
+		VkGraphicsPipelineCreateInfo graphicsInfo;
+		VkComputePipelineCreateInfo computeInfo;
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		std::vector<Specialization> specializations;
+		VkPipeline *target = nullptr;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkResult result = VK_SUCCESS;
+	};
+
+	// Entries are not moved once added, the copied create infos point into them
+	std::vector<std::unique_ptr<Entry>> entries;
+	uint32_t threadsUsed = 0;
+
+	static void copySpecialization(VkPipelineShaderStageCreateInfo &stage, Specialization &copy)
+	{
+		if (stage.pSpecializationInfo == nullptr)
+			return;
+		const VkSpecializationInfo &source = *stage.pSpecializationInfo;
+		copy.entries.assign(source.pMapEntries, source.pMapEntries + source.mapEntryCount);
+		const uint8_t *sourceData = static_cast<const uint8_t*>(source.pData);
+		copy.data.assign(sourceData, sourceData + source.dataSize);
+		copy.info = source;
+		copy.info.pMapEntries = copy.entries.data();
+		copy.info.pData = copy.data.data();
+		stage.pSpecializationInfo = &copy.info;
+	}
+
+public:
+	// Shader stages and their specialization infos are copied, all other state referenced by
+	// the create info has to stay alive until create()
+	void add(const VkGraphicsPipelineCreateInfo &createInfo, VkPipeline *target)
+	{
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->graphicsInfo = createInfo;
+		entry->stages.assign(createInfo.pStages, createInfo.pStages + createInfo.stageCount);
+		entry->specializations.resize(entry->stages.size());
+		for (size_t i = 0; i < entry->stages.size(); i++)
+		{
+			copySpecialization(entry->stages[i], entry->specializations[i]);
+		}
+		entry->graphicsInfo.pStages = entry->stages.data();
+		entry->target = target;
+		entries.push_back(std::move(entry));
+	}
+
+	void add(const VkComputePipelineCreateInfo &createInfo, VkPipeline *target)
+	{
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->compute = true;
+		entry->computeInfo = createInfo;
+		entry->specializations.resize(1);
+		copySpecialization(entry->computeInfo.stage, entry->specializations[0]);
+		entry->target = target;
+		entries.push_back(std::move(entry));
+	}
+
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(entries.size());
+	}
+
+	// Threads actually used by the last create()
+	uint32_t threads() const
+	{
+		return threadsUsed;
+	}
+
+	// Creates every added pipeline and stores it in its target, 0 threads uses every hardware thread
+	void create(VkDevice device, VkPipelineCache cache, uint32_t threadCount = 0)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		threadsUsed = std::max(std::min(threadCount, size()), 1u);
+
+		std::atomic<uint32_t> next(0);
+		auto work = [&]() {
+			for (uint32_t i = next++; i < entries.size(); i = next++)
+			{
+				Entry &entry = *entries[i];
+				if (entry.compute)
+					entry.result = vkCreateComputePipelines(device, cache, 1, &entry.computeInfo, nullptr, &entry.pipeline);
+				else
+					entry.result = vkCreateGraphicsPipelines(device, cache, 1, &entry.graphicsInfo, nullptr, &entry.pipeline);
+			}
+		};
+		// The calling thread takes part as well
+		std::vector<std::thread> workers;
+		for (uint32_t t = 1; t < threadsUsed; t++)
+		{
+			workers.emplace_back(work);
+		}
+		work();
+		for (auto &worker : workers)
+		{
+			worker.join();
+		}
+
+		for (auto &entry : entries)
+		{
+			VK_CHECK_RESULT(entry->result);
+			*entry->target = entry->pipeline;
+		}
+		entries.clear();
+	}
+};
@@ -0,0 +1,626 @@
+/*
+* Render graph of the TAA frame
+*
+* Passes declare the images they read and write, with the stage, access and layout of every
+* use. compile() drops the passes no side effect depends on, orders the others after the
+* writers of what they read and works out the state each image enters the frame in, which
+* is the state the frame before left it in. record() then puts one pipeline barrier in front
+* of a pass, covering only the images whose layout changes or whose last use conflicts.
+*
+* History resources are two images swapping roles every frame: CURRENT is written by the
+* frame of the given parity and read as PREVIOUS by the next one. Only images are tracked,
+* buffers and swapchain images stay with the passes and render passes using them.
+*
+* Passes marked async() run on a queue of a compute only family. The compiled order is split
+* into segments of passes on the same queue, each recorded into a command buffer of its own
+* and submitted in order with a semaphore between consecutive segments. An image changing
+* queues with its contents kept is released at the end of the segment that used it last and
+* acquired by the pass using it next, possibly one of the next frame. Discarded images are
+* simply taken over.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.h"
+
+class RenderGraph
+{
+public:
+	typedef uint32_t Resource;
+
+	enum Version {
+		CURRENT = 0,
+		// History resources only, the image written by the previous frame
+		PREVIOUS
+	};
+
+	enum Queue {
+		GRAPHICS = 0,
+		ASYNC_COMPUTE
+	};
+
+	// record() into a single command buffer, every pass runs on the graphics queue then
+	static const uint32_t ALL_SEGMENTS = ~0u;
+
+	// index is the swapchain image the command buffer is recorded for
+	typedef std::function<void(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t index)> RecordFunction;
+
+	struct Access {
+		Resource resource;
+		Version version;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		// Layout after the pass when a render pass moves the image into its final layout
+		VkImageLayout finalLayout;
+		bool write;
+		// Every texel is cleared or overwritten, the old contents are not kept
+		bool discard;
+	};
+
+	class Pass
+	{
+		friend class RenderGraph;
+		std::string name;
+		RecordFunction record;
+		std::vector<Access> accesses;
+		bool sideEffect = false;
+		Queue queue = GRAPHICS;
+
+		Pass &add(Resource resource, Version version, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, VkImageLayout finalLayout, bool write, bool discard)
+		{
+			Access a = { resource, version, stages, access, layout, (finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) ? finalLayout : layout, write, discard };
+			accesses.push_back(a);
+			return *this;
+		}
+
+	public:
+		// Sampled, fetched or read as input attachment
+		Pass &read(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, Version version = CURRENT)
+		{
+			return add(resource, version, stages, access, layout, VK_IMAGE_LAYOUT_UNDEFINED, false, false);
+		}
+
+		// Loaded attachments and partial writes keep discard false, they also read the image
+		Pass &write(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool discard, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			return add(resource, CURRENT, stages, access, layout, finalLayout, true, discard);
+		}
+
+		// Presents, or writes something read outside the graph, never culled
+		Pass &output()
+		{
+			sideEffect = true;
+			return *this;
+		}
+
+		// Runs on the async compute queue, compute dispatches only
+		Pass &async()
+		{
+			queue = ASYNC_COMPUTE;
+			return *this;
+		}
+	};
+
+private:
+	struct ResourceInfo {
+		std::string name;
+		VkImage images[2];
+		bool history;
+		VkImageAspectFlags aspect;
+		// Layout between frames, also what is read outside the graph
+		VkImageLayout restingLayout;
+		uint32_t firstImage;
+		std::vector<Resource> aliases;
+	};
+
+	struct ImageState {
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStages;
+		VkAccessFlags writeAccess;
+		// Uses the last write or layout transition is already visible to
+		VkPipelineStageFlags readStages;
+		VkAccessFlags readAccess;
+		// Queue owning the image. When released, the other queue's acquire moving it from
+		// releaseLayout into layout is still to be recorded.
+		Queue queue;
+		bool released;
+		VkImageLayout releaseLayout;
+	};
+
+	struct Segment {
+		Queue queue;
+		// Positions in order, end excluded
+		uint32_t first, end;
+	};
+
+	std::vector<ResourceInfo> resources;
+	std::vector<Pass> passes;
+	// Indices into passes, in recording order
+	std::vector<uint32_t> order;
+	std::vector<Segment> segments;
+	uint32_t queueFamilies[2] = { VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED };
+	std::vector<uint32_t> imageResources;
+	std::vector<ImageState> entryStates[2];
+	uint32_t imageBarriers[2] = {};
+
+	uint32_t imageIndex(Resource resource, Version version, uint32_t parity) const
+	{
+		const ResourceInfo &info = resources[resource];
+		if (!info.history)
+			return info.firstImage;
+		return info.firstImage + ((version == CURRENT) ? parity : 1 - parity);
+	}
+
+	std::vector<ImageState> restingStates() const
+	{
+		std::vector<ImageState> states(imageResources.size());
+		for (uint32_t i = 0; i < states.size(); i++)
+		{
+			states[i] = { resources[imageResources[i]].restingLayout, 0, 0, 0, 0, GRAPHICS, false, VK_IMAGE_LAYOUT_UNDEFINED };
+		}
+		return states;
+	}
+
+	static bool writes(const Pass &pass, Resource resource)
+	{
+		for (const auto &a : pass.accesses)
+		{
+			if (a.write && a.resource == resource)
+				return true;
+		}
+		return false;
+	}
+
+	// Memory shared with other images holds their data, never keep it
+	bool discards(const Access &a) const
+	{
+		return a.write && (a.discard || !resources[a.resource].aliases.empty());
+	}
+
+	// Readers of the image on the same queue that follow in the same layout without a write in
+	// between, a layout transition is made visible to all of them at once
+	void laterReads(uint32_t position, uint32_t image, VkImageLayout layout, uint32_t parity, Queue queue, VkPipelineStageFlags &stages, VkAccessFlags &access) const
+	{
+		for (uint32_t p = position + 1; p < order.size(); p++)
+		{
+			const Pass &pass = passes[order[p]];
+			for (const auto &a : pass.accesses)
+			{
+				if (imageIndex(a.resource, a.version, parity) != image)
+					continue;
+				if (a.write || a.layout != layout || pass.queue != queue)
+					return;
+				stages |= a.stages;
+				access |= a.access;
+			}
+		}
+	}
+
+	// First access of the image after position, in this frame or in the next one
+	const Access *nextAccess(uint32_t position, uint32_t image, uint32_t parity, Queue &queue) const
+	{
+		for (uint32_t frame = 0; frame < 2; frame++)
+		{
+			const uint32_t frameParity = (frame == 0) ? parity : 1 - parity;
+			for (uint32_t p = (frame == 0) ? position + 1 : 0; p < order.size(); p++)
+			{
+				const Pass &pass = passes[order[p]];
+				for (const auto &a : pass.accesses)
+				{
+					if (imageIndex(a.resource, a.version, frameParity) != image)
+						continue;
+					queue = pass.queue;
+					return &a;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	VkImageMemoryBarrier imageBarrier(uint32_t image, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) const
+	{
+		const ResourceInfo &info = resources[imageResources[image]];
+		VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.image = info.images[image - info.firstImage];
+		barrier.subresourceRange = { info.aspect, 0, 1, 0, 1 };
+		return barrier;
+	}
+
+	// Release or acquire half of a queue family ownership transfer, both sides use the same layouts
+	VkImageMemoryBarrier ownershipBarrier(uint32_t image, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout, Queue from, Queue to) const
+	{
+		VkImageMemoryBarrier barrier = imageBarrier(image, srcAccess, dstAccess, oldLayout, newLayout);
+		barrier.srcQueueFamilyIndex = queueFamilies[from];
+		barrier.dstQueueFamilyIndex = queueFamilies[to];
+		return barrier;
+	}
+
+	static void pipelineBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages, const std::vector<VkImageMemoryBarrier> &barriers)
+	{
+		if (cmdBuffer == VK_NULL_HANDLE || barriers.empty())
+			return;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			srcStages ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+			dstStages,
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(barriers.size()), barriers.data());
+	}
+
+	// Runs the compiled passes from the given states, recording barriers and passes of the
+	// given segment into cmdBuffer unless it is VK_NULL_HANDLE. Returns the number of image
+	// barriers of all segments.
+	uint32_t execute(uint32_t parity, uint32_t index, std::vector<ImageState> &states, VkCommandBuffer cmdBuffer, uint32_t segment, bool recordPasses) const
+	{
+		uint32_t barrierCount = 0;
+		for (uint32_t s = 0; s < segments.size(); s++)
+		{
+			const Segment &seg = segments[s];
+			VkCommandBuffer segmentCmd = (segment == ALL_SEGMENTS || segment == s) ? cmdBuffer : VK_NULL_HANDLE;
+			for (uint32_t position = seg.first; position < seg.end; position++)
+			{
+				const Pass &pass = passes[order[position]];
+				std::vector<VkImageMemoryBarrier> barriers;
+				VkPipelineStageFlags srcStages = 0, dstStages = 0;
+				for (const auto &a : pass.accesses)
+				{
+					const uint32_t image = imageIndex(a.resource, a.version, parity);
+					const ResourceInfo &info = resources[a.resource];
+					ImageState &state = states[image];
+					const bool discard = discards(a);
+					// Last used on the other queue, the semaphores between the segments order the uses
+					const bool otherQueue = (state.queue != seg.queue);
+					const bool transition = discard || otherQueue || a.layout != state.layout;
+
+					VkPipelineStageFlags src = 0;
+					VkAccessFlags srcAccess = 0;
+					VkPipelineStageFlags dst = a.stages;
+					VkAccessFlags dstAccess = a.access;
+					bool needed = transition;
+					if (transition || a.write)
+					{
+						// Waits for every use since the last write and for the write itself
+						if (!otherQueue)
+						{
+							src = state.writeStages | state.readStages;
+							srcAccess = state.writeAccess;
+						}
+						if (a.write)
+						{
+							for (Resource alias : info.aliases)
+							{
+								for (uint32_t v = 0; v < (resources[alias].history ? 2u : 1u); v++)
+								{
+									const ImageState &aliasState = states[resources[alias].firstImage + v];
+									if (aliasState.queue != seg.queue)
+										continue;
+									src |= aliasState.writeStages | aliasState.readStages;
+									srcAccess |= aliasState.writeAccess;
+								}
+							}
+						}
+						needed |= (src != 0);
+						if (transition && !a.write)
+							laterReads(position, image, a.layout, parity, seg.queue, dst, dstAccess);
+					}
+					else if ((a.stages & ~state.readStages) || (a.access & ~state.readAccess))
+					{
+						src = state.writeStages;
+						srcAccess = state.writeAccess;
+						needed = (src != 0);
+					}
+
+					if (needed)
+					{
+						srcStages |= src;
+						dstStages |= dst;
+						if (otherQueue && state.released)
+							barriers.push_back(ownershipBarrier(image, 0, dstAccess, state.releaseLayout, state.layout, state.queue, seg.queue));
+						else
+							// Without a release the other queue's contents are not kept either
+							barriers.push_back(imageBarrier(image, srcAccess, dstAccess, (discard || otherQueue) ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout, a.layout));
+					}
+
+					if (a.write)
+					{
+						state.writeStages = a.stages;
+						state.writeAccess = a.access;
+						state.readStages = 0;
+						state.readAccess = 0;
+					}
+					else if (transition)
+					{
+						// The transition counts as a write, seen by the readers collected above
+						state.writeStages = dst;
+						state.writeAccess = 0;
+						state.readStages = dst;
+						state.readAccess = dstAccess;
+					}
+					else if (needed)
+					{
+						state.readStages |= dst;
+						state.readAccess |= dstAccess;
+					}
+					state.layout = a.finalLayout;
+					state.queue = seg.queue;
+					state.released = false;
+				}
+				pipelineBarrier(segmentCmd, srcStages, dstStages, barriers);
+				barrierCount += static_cast<uint32_t>(barriers.size());
+				if (segmentCmd != VK_NULL_HANDLE && recordPasses)
+					pass.record(segmentCmd, parity, index);
+			}
+
+			// Images used next on the other queue with their contents kept are handed over in
+			// the layout of that use
+			std::vector<VkImageMemoryBarrier> barriers;
+			VkPipelineStageFlags srcStages = 0;
+			for (uint32_t image = 0; image < states.size(); image++)
+			{
+				ImageState &state = states[image];
+				Queue queue;
+				const Access *next = (state.queue == seg.queue && !state.released) ? nextAccess(seg.end - 1, image, parity, queue) : nullptr;
+				if (next == nullptr || queue == seg.queue || discards(*next))
+					continue;
+				srcStages |= state.writeStages | state.readStages;
+				barriers.push_back(ownershipBarrier(image, state.writeAccess, 0, state.layout, next->layout, seg.queue, queue));
+				state = { next->layout, 0, 0, 0, 0, seg.queue, true, state.layout };
+			}
+			pipelineBarrier(segmentCmd, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, barriers);
+			barrierCount += static_cast<uint32_t>(barriers.size());
+
+			// Back into the resting layouts for whatever reads the images outside the graph,
+			// done by the last segment of the queue owning the image
+			bool lastOfQueue = true;
+			for (uint32_t later = s + 1; later < segments.size(); later++)
+			{
+				lastOfQueue &= (segments[later].queue != seg.queue);
+			}
+			if (!lastOfQueue)
+				continue;
+			barriers.clear();
+			srcStages = 0;
+			for (uint32_t image = 0; image < states.size(); image++)
+			{
+				ImageState &state = states[image];
+				const VkImageLayout restingLayout = resources[imageResources[image]].restingLayout;
+				if (state.queue != seg.queue || state.released || state.layout == restingLayout)
+					continue;
+				srcStages |= state.writeStages | state.readStages;
+				barriers.push_back(imageBarrier(image, state.writeAccess, 0, state.layout, restingLayout));
+				state = { restingLayout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, 0, seg.queue, false, VK_IMAGE_LAYOUT_UNDEFINED };
+			}
+			pipelineBarrier(segmentCmd, srcStages, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, barriers);
+			barrierCount += static_cast<uint32_t>(barriers.size());
+		}
+		return barrierCount;
+	}
+
+public:
+	Resource addImage(const std::string &name, VkImage image, VkImageAspectFlags aspect, VkImageLayout restingLayout)
+	{
+		ResourceInfo info = { name, { image, VK_NULL_HANDLE }, false, aspect, restingLayout, static_cast<uint32_t>(imageResources.size()), {} };
+		imageResources.push_back(static_cast<uint32_t>(resources.size()));
+		resources.push_back(info);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	// images[p] is the CURRENT image of parity p and the PREVIOUS image of parity 1 - p
+	Resource addHistory(const std::string &name, VkImage image0, VkImage image1, VkImageAspectFlags aspect, VkImageLayout restingLayout)
+	{
+		ResourceInfo info = { name, { image0, image1 }, true, aspect, restingLayout, static_cast<uint32_t>(imageResources.size()), {} };
+		imageResources.push_back(static_cast<uint32_t>(resources.size()));
+		imageResources.push_back(static_cast<uint32_t>(resources.size()));
+		resources.push_back(info);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	// The images share memory, writing one waits for the other's uses and drops its contents
+	void alias(Resource a, Resource b)
+	{
+		resources[a].aliases.push_back(b);
+		resources[b].aliases.push_back(a);
+	}
+
+	VkImage image(Resource resource, Version version, uint32_t parity) const
+	{
+		const ResourceInfo &info = resources[resource];
+		return info.images[imageIndex(resource, version, parity) - info.firstImage];
+	}
+
+	// Families of the queues passes run on, needed by the ownership transfers of async passes
+	void setQueueFamilies(uint32_t graphics, uint32_t asyncCompute)
+	{
+		queueFamilies[GRAPHICS] = graphics;
+		queueFamilies[ASYNC_COMPUTE] = asyncCompute;
+	}
+
+	// Passes are declared again whenever the frame changes, resources stay
+	void clearPasses()
+	{
+		passes.clear();
+		order.clear();
+	}
+
+	// The reference stays valid until the next addPass()
+	Pass &addPass(const std::string &name, RecordFunction record)
+	{
+		passes.push_back(Pass());
+		passes.back().name = name;
+		passes.back().record = record;
+		return passes.back();
+	}
+
+	// Moves every image from VK_IMAGE_LAYOUT_UNDEFINED into the state the first frame of parity 0
+	// expects, once at startup on the graphics queue after compile(). Images the first frame
+	// acquires are released here, images it expects on the async compute queue are taken over
+	// with undefined contents, which nothing has written yet anyway.
+	void initialize(VkCommandBuffer cmdBuffer) const
+	{
+		std::vector<VkImageMemoryBarrier> barriers, releases;
+		for (uint32_t image = 0; image < imageResources.size(); image++)
+		{
+			const ImageState &state = entryStates[0][image];
+			barriers.push_back(imageBarrier(image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, state.released ? state.releaseLayout : state.layout));
+			if (state.released)
+			{
+				assert(state.queue == GRAPHICS);
+				releases.push_back(ownershipBarrier(image, 0, 0, state.releaseLayout, state.layout, GRAPHICS, ASYNC_COMPUTE));
+			}
+		}
+		pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, barriers);
+		pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, releases);
+	}
+
+	void compile()
+	{
+		// Side effects keep their passes, reading or loading a resource keeps all of its writers
+		std::vector<bool> live(passes.size());
+		for (uint32_t p = 0; p < passes.size(); p++)
+		{
+			live[p] = passes[p].sideEffect;
+		}
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (uint32_t p = 0; p < passes.size(); p++)
+			{
+				if (!live[p])
+					continue;
+				for (const auto &a : passes[p].accesses)
+				{
+					if (a.write && a.discard)
+						continue;
+					for (uint32_t q = 0; q < passes.size(); q++)
+					{
+						if (!live[q] && writes(passes[q], a.resource))
+						{
+							live[q] = true;
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+
+		// Writers of a resource run in declaration order, before the readers of its CURRENT
+		// version. Ready passes are taken in declaration order as well.
+		std::vector<std::vector<uint32_t>> dependencies(passes.size());
+		for (uint32_t p = 0; p < passes.size(); p++)
+		{
+			for (const auto &a : passes[p].accesses)
+			{
+				if (a.version != CURRENT)
+					continue;
+				for (uint32_t q = 0; q < passes.size(); q++)
+				{
+					if (q == p || !live[q] || !writes(passes[q], a.resource))
+						continue;
+					if (!a.write || q < p)
+						dependencies[p].push_back(q);
+				}
+			}
+		}
+		order.clear();
+		std::vector<bool> done(passes.size(), false);
+		for (bool progress = true; progress;)
+		{
+			progress = false;
+			for (uint32_t p = 0; p < passes.size(); p++)
+			{
+				if (!live[p] || done[p])
+					continue;
+				bool ready = true;
+				for (uint32_t q : dependencies[p])
+				{
+					ready &= done[q];
+				}
+				if (ready)
+				{
+					order.push_back(p);
+					done[p] = true;
+					progress = true;
+					break;
+				}
+			}
+		}
+		// A cycle, two passes reading each other's CURRENT output
+		assert(order.size() == static_cast<size_t>(std::count(live.begin(), live.end(), true)));
+
+		segments.clear();
+		for (uint32_t position = 0; position < order.size(); position++)
+		{
+			const Queue queue = passes[order[position]].queue;
+			if (segments.empty() || segments.back().queue != queue)
+				segments.push_back({ queue, position, position });
+			segments.back().end = position + 1;
+		}
+
+		// Every frame starts where the frame of the other parity ended, run both twice to
+		// get there from the resting layouts
+		std::vector<ImageState> states = restingStates();
+		for (uint32_t frame = 0; frame < 4; frame++)
+		{
+			const uint32_t parity = frame % 2;
+			if (frame >= 2)
+				entryStates[parity] = states;
+			imageBarriers[parity] = execute(parity, 0, states, VK_NULL_HANDLE, ALL_SEGMENTS, false);
+		}
+	}
+
+	// Records the compiled passes of a segment for the frame of the given parity. Without
+	// recordPasses only the barriers are recorded, for a frame whose passes are dropped.
+	void record(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t index, uint32_t segment = ALL_SEGMENTS, bool recordPasses = true) const
+	{
+		std::vector<ImageState> states = entryStates[parity];
+		execute(parity, index, states, cmdBuffer, segment, recordPasses);
+	}
+
+	uint32_t segmentCount() const
+	{
+		return static_cast<uint32_t>(segments.size());
+	}
+
+	Queue segmentQueue(uint32_t segment) const
+	{
+		return segments[segment].queue;
+	}
+
+	// Compiled passes in recording order
+	std::vector<std::string> passNames() const
+	{
+		std::vector<std::string> names;
+		for (uint32_t p : order)
+		{
+			names.push_back(passes[p].name);
+		}
+		return names;
+	}
+
+	uint32_t culledPasses() const
+	{
+		return static_cast<uint32_t>(passes.size() - order.size());
+	}
+
+	// Image barriers recorded per frame of the given parity
+	uint32_t barrierCount(uint32_t parity) const
+	{
+		return imageBarriers[parity];
+	}
+};
@@ -0,0 +1,244 @@
+/*
+* Render target arena
+*
+* Places render target images in a few large device memory blocks instead of one
+* allocation per image. Every image comes with the range of frame stages it is used in,
+* images whose ranges do not overlap may share memory. An aliased image holds undefined
+* contents when its stages begin and has to be transitioned from VK_IMAGE_LAYOUT_UNDEFINED
+* and written before it is read. Only optimally tiled images are expected, so
+* bufferImageGranularity does not apply between them.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.h"
+#include "VulkanDevice.hpp"
+
+class RenderTargetArena
+{
+public:
+	// Stage range of images kept across frames, they never share memory
+	static const uint32_t PERSISTENT_FIRST = 0;
+	static const uint32_t PERSISTENT_LAST = ~0u;
+
+	struct Stats {
+		uint32_t images = 0;
+		uint32_t blocks = 0;
+		uint32_t aliasedImages = 0;
+		// Sum of the image sizes, what one allocation per image needs
+		VkDeviceSize dedicatedBytes = 0;
+		// Sum of the block sizes
+		VkDeviceSize arenaBytes = 0;
+	};
+
+private:
+	struct Resource {
+		VkImage image;
+		VkMemoryRequirements requirements;
+		uint32_t memoryType;
+		uint32_t firstStage, lastStage;
+		uint32_t block = 0;
+		VkDeviceSize offset = 0;
+		bool aliased = false;
+	};
+
+	struct Block {
+		uint32_t memoryType;
+		VkDeviceSize capacity;
+		VkDeviceSize size = 0;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+	};
+
+	vks::VulkanDevice *vulkanDevice = nullptr;
+	VkDeviceSize blockSize;
+	std::vector<Resource> resources;
+	std::vector<Block> blocks;
+
+	static bool livesOverlap(const Resource &a, const Resource &b)
+	{
+		return a.firstStage <= b.lastStage && b.firstStage <= a.lastStage;
+	}
+
+	static bool memoryOverlaps(const Resource &a, VkDeviceSize offset, VkDeviceSize size)
+	{
+		return a.offset < offset + size && offset < a.offset + a.requirements.size;
+	}
+
+	const Resource *find(VkImage image) const
+	{
+		for (const auto &resource : resources)
+		{
+			if (resource.image == image)
+				return &resource;
+		}
+		return nullptr;
+	}
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Lowest offset in the block that does not collide with an image alive at the same time
+	bool place(Resource &resource, uint32_t blockIndex, const std::vector<uint32_t> &placed)
+	{
+		const Block &block = blocks[blockIndex];
+		if (block.memoryType != resource.memoryType)
+			return false;
+		std::vector<VkDeviceSize> candidates = { 0 };
+		for (uint32_t index : placed)
+		{
+			const Resource &other = resources[index];
+			if (other.block == blockIndex && livesOverlap(resource, other))
+				candidates.push_back(alignUp(other.offset + other.requirements.size, resource.requirements.alignment));
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (VkDeviceSize offset : candidates)
+		{
+			if (offset + resource.requirements.size > block.capacity)
+				break;
+			bool free = true;
+			for (uint32_t index : placed)
+			{
+				const Resource &other = resources[index];
+				if (other.block == blockIndex && livesOverlap(resource, other) && memoryOverlaps(other, offset, resource.requirements.size))
+				{
+					free = false;
+					break;
+				}
+			}
+			if (free)
+			{
+				resource.block = blockIndex;
+				resource.offset = offset;
+				return true;
+			}
+		}
+		return false;
+	}
+
+public:
+	// Images larger than blockSize get a block of their own
+	explicit RenderTargetArena(VkDeviceSize blockSize = 64 * 1024 * 1024) : blockSize(blockSize) {}
+
+	// Stages are in frame order, firstStage to lastStage inclusive
+	void add(vks::VulkanDevice *device, VkImage image, uint32_t firstStage, uint32_t lastStage)
+	{
+		vulkanDevice = device;
+		Resource resource;
+		resource.image = image;
+		vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, image, &resource.requirements);
+		resource.memoryType = vulkanDevice->getMemoryType(resource.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		resource.firstStage = firstStage;
+		resource.lastStage = lastStage;
+		resources.push_back(resource);
+	}
+
+	// Places every added image, largest first, then allocates the blocks and binds the images
+	void allocate()
+	{
+		std::vector<uint32_t> order(resources.size());
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return resources[a].requirements.size > resources[b].requirements.size;
+		});
+
+		std::vector<uint32_t> placed;
+		for (uint32_t index : order)
+		{
+			Resource &resource = resources[index];
+			bool done = false;
+			for (uint32_t b = 0; b < blocks.size() && !done; b++)
+			{
+				done = place(resource, b, placed);
+			}
+			if (!done)
+			{
+				Block block;
+				block.memoryType = resource.memoryType;
+				block.capacity = std::max(blockSize, resource.requirements.size);
+				blocks.push_back(block);
+				place(resource, static_cast<uint32_t>(blocks.size() - 1), placed);
+			}
+			Block &block = blocks[resource.block];
+			block.size = std::max(block.size, resource.offset + resource.requirements.size);
+			placed.push_back(index);
+		}
+
+		for (auto &resource : resources)
+		{
+			for (const auto &other : resources)
+			{
+				if (&other != &resource && other.block == resource.block && !livesOverlap(resource, other) && memoryOverlaps(other, resource.offset, resource.requirements.size))
+					resource.aliased = true;
+			}
+		}
+
+		// Blocks only grow as large as their contents
+		for (auto &block : blocks)
+		{
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = block.size;
+			memAlloc.memoryTypeIndex = block.memoryType;
+			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &block.memory));
+		}
+		for (const auto &resource : resources)
+		{
+			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, resource.image, blocks[resource.block].memory, resource.offset));
+		}
+	}
+
+	// Images are destroyed by their owners, before or after the arena
+	void destroy()
+	{
+		for (auto &block : blocks)
+		{
+			vkFreeMemory(vulkanDevice->logicalDevice, block.memory, nullptr);
+		}
+		blocks.clear();
+		resources.clear();
+	}
+
+	// Whether the image shares memory with an image used in other stages
+	bool aliased(VkImage image) const
+	{
+		const Resource *resource = find(image);
+		return resource != nullptr && resource->aliased;
+	}
+
+	// Whether the two images share memory, their stages never overlap then
+	bool aliases(VkImage a, VkImage b) const
+	{
+		const Resource *resourceA = find(a);
+		const Resource *resourceB = find(b);
+		if (resourceA == nullptr || resourceB == nullptr || resourceA == resourceB || resourceA->block != resourceB->block)
+			return false;
+		return memoryOverlaps(*resourceA, resourceB->offset, resourceB->requirements.size);
+	}
+
+	Stats stats() const
+	{
+		Stats stats;
+		stats.images = static_cast<uint32_t>(resources.size());
+		stats.blocks = static_cast<uint32_t>(blocks.size());
+		for (const auto &resource : resources)
+		{
+			stats.dedicatedBytes += resource.requirements.size;
+			stats.aliasedImages += resource.aliased ? 1 : 0;
+		}
+		for (const auto &block : blocks)
+		{
+			stats.arenaBytes += block.size;
+		}
+		return stats;
+	}
+};
@@ -27,85 +27,94 @@
 #include <assert.h>
 #include <vector>
 #include <random>
+#include <iostream>
+#include <chrono>
+#include <memory>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <vulkan/vulkan.h>
+#if defined(TAA_HEADLESS)
+#include "headlessexamplebase.h"
+#else
 #include "vulkanexamplebase.h"
+#endif
 #include "VulkanTexture.hpp"
-#include "VulkanModel.hpp"
+#include "passprofiler.hpp"
+#include "taareference.hpp"
+#include "jittersequence.hpp"
+#include "pipelinecache.hpp"
+#include "rendertargetarena.hpp"
+#include "rendergraph.hpp"
+#include "meshfile.hpp"
 #include<math.h>
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 #define SHADOWMAP_DIM 512
+// Work group size of the compute resolve, must match TILE_SIZE in TemprolReprojectionMotion.comp
+#define RESOLVE_TILE_SIZE 16
+// Pixels per velocity tile side, must match TILE_SIZE in velocityTileMax.comp
+#define VELOCITY_TILE_SIZE 16
+// Depth target of the building pass, sampled by the closest fragment search of velocityDilate.comp
+#define BUILDING_DEPTH_FORMAT VK_FORMAT_D16_UNORM
+// Work group size of velocityDilate.comp
+#define VELOCITY_DILATE_GROUP_SIZE 16
+// Dilated velocity read by the resolve: uv velocity and linear depth of the closest fragment.
+// Half floats whatever the velocity format, linear filtering and storage are both mandatory for it.
+#define DILATED_VELOCITY_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+// Work group size of velocityNeighborMax.comp
+#define VELOCITY_NEIGHBOR_GROUP_SIZE 8
+// R16G16_SNORM velocity stores uv velocity * 4: up to a quarter of the screen per frame,
+// quantized to 1 / (4 * 32767) uv, about 0.03 pixels at 3840 wide
+#define VELOCITY_SNORM_SCALE 4.0f
+// Largest per channel difference (1/255 steps) between the GPU resolve and the CPU reference.
+// Texture units filter with a few bits of subtexel precision and the dither amplifies any
+// difference in sin(), either may move a channel by one step.
+#define CPU_REFERENCE_TOLERANCE 2
+// -dynamicresolution never renders below this fraction of the window and changes the scale
+// in steps of DYNAMIC_RESOLUTION_STEP
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_STEP 0.05f
+// Below this fraction of the target for DYNAMIC_RESOLUTION_RAISE_FRAMES measured frames the
+// scale goes up one step, above the target it drops right away
+#define DYNAMIC_RESOLUTION_HEADROOM 0.85f
+#define DYNAMIC_RESOLUTION_RAISE_FRAMES 30
 class FrustumJitter
 {
 public:
-	float* points_Halton_2_3_x16 = new float[16 * 2];
-	int m_currentIndex = 0;
+	JitterSequence sequence = jitterSequence(JITTER_HALTON_16);
+	uint32_t m_currentIndex = 0;
+	// xy = offset of the current frame, zw = offset of the next one, in pixels
 	glm::vec4 activeSample = glm::vec4(0.0);
 
 public:
-	FrustumJitter()
+	void SetPattern(JitterPattern pattern)
 	{
-
-		InitializeHalton_2_3(points_Halton_2_3_x16, 32);
-
-	}
-	~FrustumJitter() {
-		delete[]points_Halton_2_3_x16;
-	}
-	glm::vec2 Sample(int index)
-	{
-		float patternScale = 1.0f;
-		float* points = new float[16 * 2];
-		int n = 16;
-		int i = index % n;
-
-		float x = patternScale * points[2 * i + 0];
-		float y = patternScale * points[2 * i + 1];
-		return glm::vec2(x, y);
-	}
-
-
-	float HaltonSeq(uint32_t prime, uint32_t index)
-	{
-		float r = 0.0f;
-		float f = 1.0f;
-		uint32_t i = index;
-		while (i > 0)
-		{
-			f /= prime;
-			r += f * (i % prime);
-			i = (uint32_t)std::floorf(i / (float)prime);
-		}
-		return r;
+		sequence = jitterSequence(pattern);
+		m_currentIndex = 0;
 	}
 
-	void InitializeHalton_2_3(float* seq, int len)
+	glm::vec2 Sample(uint32_t index) const
 	{
-		for (int i = 0, n = len / 2; i != n; i++)
-		{
-			float u = HaltonSeq(2, i + 1) - 0.5f;
-			float v = HaltonSeq(3, i + 1) - 0.5f;
-			seq[2 * i + 0] = u;
-			seq[2 * i + 1] = v;
-		}
+		uint32_t i = index % sequence.count;
+		return glm::vec2(sequence.points[i][0], sequence.points[i][1]);
 	}
 
-	glm::vec2 GetHaltonJitter(uint64_t index)
+	// Moves the next offset into xy and returns it
+	glm::vec2 Advance()
 	{
 		activeSample.x = activeSample.z;
 		activeSample.y = activeSample.w;
-		//glm::vec2 zw=Sample(index);
-		activeSample.z = points_Halton_2_3_x16[index % 16];
-		activeSample.w = points_Halton_2_3_x16[(index % 16) + 1];
-		
-		m_currentIndex = (m_currentIndex + 2) % 32;
+		glm::vec2 next = Sample(m_currentIndex);
+		activeSample.z = next.x;
+		activeSample.w = next.y;
+
+		m_currentIndex = (m_currentIndex + 1) % sequence.count;
 		return glm::vec2(activeSample.x, activeSample.y);
 	}
 
@@ -137,22 +146,37 @@ public:
 
 	int current = 0;
 	int first = 0;
-	// Vertex layout for the models
-
-
-	vks::VertexLayout vertexLayout = vks::VertexLayout({
-		vks::VERTEX_COMPONENT_POSITION,
-		vks::VERTEX_COMPONENT_NORMAL,
-		vks::VERTEX_COMPONENT_UV,
-
-		});
+	// Vertex streams and index buffer of a model loaded by loadModel(), in the layouts of
+	// MeshFile::sceneStreams(). The velocity pass only fetches the positions.
+	struct Mesh {
+		vks::Buffer positions;
+		// Octahedral snorm16 normal and half float UV
+		vks::Buffer attributes;
+		vks::Buffer indices;
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+
+		void destroy()
+		{
+			positions.destroy();
+			attributes.destroy();
+			indices.destroy();
+		}
+	};
 	struct {
-		vks::Model scene;
+		Mesh scene;
 	} models;
-
+	// -mesh PATH replaces the scene model. A .taamesh written by taa_meshconvert is memory
+	// mapped, other formats are imported with Assimp on every start.
+	struct MeshLoad {
+		std::string path;
+		bool mapped = false;
+		double ms = 0.0;
+	} meshLoad;
+
+	// Model matrices come from the instance buffer
 	struct UBOSceneMatrices {
 		glm::mat4 projection;
-		glm::mat4 model;
 		glm::mat4 view;
 	} uboSceneMatrices;
 
@@ -172,38 +196,323 @@ public:
 		VkRenderPass renderPass;
 		std::vector<FrameBuffer> framebuffers;
 	};
+	// Order of the work within a frame. Render targets live from the first to the last stage
+	// using them, the arena lets targets with disjoint stages share memory.
+	enum FrameStage {
+		STAGE_BUILDING = 0,
+		STAGE_VELOCITY,
+		STAGE_VELOCITY_DILATE,
+		STAGE_VELOCITY_PRECISION,
+		STAGE_VELOCITY_TILE_MAX,
+		STAGE_VELOCITY_NEIGHBOR_MAX,
+		STAGE_RESOLVE,
+		STAGE_QUAD,
+		// Copies of -cpureference, submitted after the frame
+		STAGE_READBACK
+	};
+	// Memory of every render target, the FrameBufferAttachment::mem handles stay empty
+	RenderTargetArena renderTargets;
 	VkSampler colorsampler;
 	struct UBO1 {
 
 		glm::mat4 _CurrVP;
-		glm::mat4 _CurrM;
 		glm::mat4 _PrevVP;
-		glm::mat4 _PrevM;
+		// Read by vertexAnimation.comp: x = animation time, y = 1 when the previous positions
+		// have to be written as well
+		glm::vec4 _AnimationTime;
 
 
 	} velocity_ubo;
+	// Model matrices of this and the previous frame for every instance of models.scene, read by
+	// the building and velocity vertex shaders through gl_InstanceIndex. -instances N draws N
+	// instances with one instanced draw per pass.
+	struct InstanceTransform {
+		glm::mat4 curr;
+		glm::mat4 prev;
+	};
+	struct Instances {
+		uint32_t count = 1;
+		// Last uploaded transforms, their curr matrices become the prev matrices of the next frame
+		std::vector<InstanceTransform> transforms;
+		// One aligned slice per swapchain image like the uniform rings, so the slice written for
+		// a frame is never the one a frame in flight reads
+		vks::Buffer buffer;
+		VkDeviceSize stride;
+	} instances;
 	struct UBO2 {
 
 		glm::vec4 _SinTime;
 		glm::vec4 _FeedbackMin_Max_Mscale;
 		glm::vec4 JitterUV;
-
+		// xy = render size / history size
+		glm::vec4 _RenderScale;
 
 	} temprolReproj_ubo;
 	// Resources for the graphics part of the example
 	struct Graphics {
+		// One aligned slice per swapchain image, bound with a dynamic offset
 		vks::Buffer uniformbuffer;
+		VkDeviceSize uniformStride;
 		VkDescriptorSetLayout descriptorSetLayout;
 		VkDescriptorSet descriptorSet;
 		VkPipeline pipeline;
 		VkPipelineLayout pipelineLayout;
 		OffscreenPass pass;
-	} velocity, temproalReproj, velocityMax, building;
+	} velocity, temproalReproj, building;
+
+	// Two stage velocity reduction: longest velocity per tile, then the longest of the
+	// 3x3 neighbouring tiles. Both targets hold one texel per tile and rest in GENERAL.
+	struct VelocityTiles {
+		uint32_t width, height;
+		FrameBufferAttachment tileMax, neighborMax;
+		VkDescriptorSetLayout descriptorSetLayout;
+		// Per parity, tileMax reads the velocity target of inputTarget(parity)
+		std::array<VkDescriptorSet, 2> tileMaxDescriptorSets;
+		VkDescriptorSet neighborMaxDescriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline tileMaxPipeline, neighborMaxPipeline;
+	} velocityTiles;
+
+	// Closest depth dilation ahead of the resolve: every pixel takes the velocity of the nearest
+	// fragment of its 3x3 neighbourhood. The target rests in SHADER_READ_ONLY_OPTIMAL.
+	struct VelocityDilate {
+		FrameBufferAttachment target;
+		VkDescriptorSetLayout descriptorSetLayout;
+		// Per parity, reads the depth and velocity targets of inputTarget(parity)
+		std::array<VkDescriptorSet, 2> descriptorSets;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} velocityDilate;
+
+	// Compute variant of the temporal resolve, writes the history targets as storage images
+	struct Compute {
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::array<VkDescriptorSet, 2> descriptorSets;
+		VkPipeline pipeline;
+		VkPipelineLayout pipelineLayout;
+	} temproalReprojCompute;
+	bool useComputeResolve = false;
+
+	// Features of the fragment resolve, specialization constants 1 to 3 of TemprolReprojection.frag.
+	// preparePipelines() creates a pipeline for every combination, so switching only re-records.
+	enum ResolveMinMax {
+		RESOLVE_MINMAX_3X3 = 0,
+		RESOLVE_MINMAX_3X3_ROUNDED,
+		RESOLVE_MINMAX_4TAP_VARYING,
+		RESOLVE_MINMAX_COUNT
+	};
+	struct ResolveVariant {
+		// USE_OPTIMIZATIONS: clip the history towards the box centre only
+		bool fastClip = false;
+		int32_t minMax = RESOLVE_MINMAX_3X3_ROUNDED;
+		bool motionBlur = false;
+	} resolveVariant;
+	// Indexed by resolveVariantIndex()
+	std::vector<VkPipeline> resolvePipelines;
+	// Colour math precision of both resolves, -resolveprecision auto|fp16|fp32. fp16 loads the
+	// RESOLVE_FP16 build of the shaders (float16_t colours), which needs the shaderFloat16 feature.
+	// auto picks it wherever the device reports the feature, auto and fp16 fall back to fp32
+	// wherever it is missing
+	enum ResolvePrecision {
+		RESOLVE_PRECISION_AUTO = 0,
+		RESOLVE_PRECISION_FP16,
+		RESOLVE_PRECISION_FP32
+	};
+	ResolvePrecision resolvePrecision = RESOLVE_PRECISION_AUTO;
+	// Set by getEnabledFeatures() when the device reports and enables shaderFloat16
+	bool shaderFloat16 = false;
+	VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16Int8Features{};
+	// Set by prepareResolvePrecision()
+	bool resolveFp16 = false;
+
+	// -subpasses: the temporal resolve and the quad share the swapchain render pass. Subpass 0
+	// resolves into the history target, subpass 1 reads it back as input attachment for the
+	// quad and the UI. frameBuffers then hold one framebuffer per history parity and image.
+	bool useSubpasses = false;
+	// Same attachments with the history target loaded, used behind the compute resolve
+	VkRenderPass subpassLoadRenderPass = VK_NULL_HANDLE;
+
+	// Frames the CPU may record ahead of the GPU, -framesinflight (1 to 3)
+	uint32_t framesInFlight = 2;
+	struct FrameSync {
+		VkFence fence;
+		VkSemaphore presentComplete;
+		VkSemaphore renderComplete;
+	};
+	std::vector<FrameSync> frameSync;
+	uint32_t frameIndex = 0;
+	// Fence of the last frame that used each swapchain image, its command buffers and its
+	// uniform buffer slice
+	std::vector<VkFence> imageFences;
+	// Set when present reports VK_ERROR_OUT_OF_DATE_KHR or VK_SUBOPTIMAL_KHR, draw() recreates
+	// the swapchain once the frame is submitted
+	bool swapChainOutOfDate = false;
+	// Uniform buffer slice written by updateTemproalUniformBuffers
+	uint32_t uniformSlice = 0;
+	uint32_t uniformSliceCount = 0;
+
+	// Storage of the per pixel velocity target, selected with -velocityformat
+	enum VelocityFormat {
+		VELOCITY_RGBA32F = 0,
+		VELOCITY_RG16F,
+		VELOCITY_RG16_SNORM
+	};
+	VelocityFormat velocityFormat = VELOCITY_RGBA32F;
+	float velocityScale = 1.0f;
+	// Velocity is written by the building pass as a second color attachment, -velocitypass
+	// falls back to the separate velocity geometry pass
+	bool velocityMRT = true;
+	// Fed to the VELOCITY_SCALE specialization constant of every velocity writer and reader
+	VkSpecializationMapEntry velocityScaleEntry;
+	VkSpecializationInfo velocityScaleInfo;
+
+	// -velocityprecision: renders the velocity a second time into a fp32 reference target and
+	// compares it against the compact one every frame (velocityCompare.comp)
+	struct VelocityPrecision {
+		bool enabled = false;
+		OffscreenPass pass;
+		VkPipeline pipeline;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline comparePipeline;
+		vks::Buffer result;
+		float maxError = 0.0f;
+		uint32_t errorPixels = 0;
+	} velocityPrecision;
+
+	// -vertexanimation: a compute pre-pass deforms the scene model once per frame into
+	// positions[parity]. The building and velocity passes read it as position stream, together
+	// with positions[1 - parity], last frame's positions, for the object velocity.
+	struct VertexAnimation {
+		bool enabled = false;
+		std::array<vks::Buffer, 2> positions;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::array<VkDescriptorSet, 2> descriptorSets;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} vertexAnimation;
+
+	// -renderscale: the building, velocity and velocity tile passes render at a fraction of the
+	// window size and the temporal resolve upsamples into the full size history (TAAU)
+	float renderScale = 1.0f;
+	// Size of the building targets and the viewport rendered into them, smaller with -dynamicresolution
+	uint32_t renderTargetWidth, renderTargetHeight;
+	uint32_t renderWidth, renderHeight;
+
+	// -dynamicresolution MS: scales the viewport inside the building targets to hold MS of
+	// measured GPU pass time, between DYNAMIC_RESOLUTION_MIN_SCALE and -renderscale
+	struct DynamicResolution {
+		bool enabled = false;
+		float targetMs = 8.0f;
+		float scale = 1.0f;
+		// Exponential average of the measured frames since the last change
+		float averageMs = 0.0f;
+		uint32_t collectedFrames = 0;
+		// Measurements still from command buffers recorded before the last change
+		uint32_t settleFrames = 0;
+		uint32_t headroomFrames = 0;
+		uint32_t changes = 0;
+		// Render size each command buffer was recorded with, per history parity
+		std::array<std::vector<VkExtent2D>, 2> recordedSize;
+	} dynamicResolution;
+
+	// -cpureference: copies the inputs and the output of the temporal resolve to the host
+	// every frame and checks the output against TaaReference (taareference.hpp)
+	struct CpuReference {
+		bool enabled = false;
+		std::unique_ptr<TaaReference> reference;
+		// Building color, dilated velocity, previous history and current history, in this order
+		vks::Buffer readback;
+		VkDeviceSize velocityOffset, previousOffset, currentOffset;
+		// Per history parity, like historyCmdBuffers
+		std::array<VkCommandBuffer, 2> cmdBuffers;
+		std::vector<float> velocity;
+		std::vector<uint8_t> output;
+		uint32_t maxDifference = 0;
+		uint32_t pixelsAboveTolerance = 0;
+		uint32_t worstDifference = 0;
+		uint32_t framesAboveTolerance = 0;
+		uint32_t frames = 0;
+		double resolveMs = 0.0;
+		// With the float16_t resolve: the GPU output against the fp32 reference as well, the
+		// precision loss of RESOLVE_FP16 on this device
+		std::vector<uint8_t> outputFp32;
+		uint32_t fp32MaxDifference = 0;
+		uint32_t fp32PixelsAboveOne = 0;
+		uint32_t fp32WorstDifference = 0;
+	} cpuReference;
+
+	// History ping-pong: parity p resolves into temproalReproj.pass.framebuffers[p],
+	// reads the previous frame from [1 - p] and presents [p] with the quad pass
+	std::array<VkDescriptorSet, 2> historyDescriptorSets;
+	std::array<VkDescriptorSet, 2> quadDescriptorSets;
+	std::array<std::vector<VkCommandBuffer>, 2> historyCmdBuffers;
+	// Per parity, the velocity pass samples the depth target of inputTarget(parity)
+	std::array<VkDescriptorSet, 2> velocityDescriptorSets;
+
+	// -asynccompute: the post chain (velocity tiles and compute resolve) runs on a queue of a
+	// compute only family, overlapping the geometry of the next frame. The building and velocity
+	// targets are then double buffered by parity and the quad of frame N is submitted, and
+	// presented, behind the geometry of frame N + 1.
+	struct AsyncCompute {
+		bool enabled = false;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandPool cmdPool = VK_NULL_HANDLE;
+		// Per history parity and swapchain image, historyCmdBuffers hold the geometry
+		std::array<std::vector<VkCommandBuffer>, 2> cmdBuffers;
+		std::array<std::vector<VkCommandBuffer>, 2> postCmdBuffers;
+		// Per frame in flight, geometry to compute and compute to post chain
+		std::vector<VkSemaphore> graphicsDone;
+		std::vector<VkSemaphore> computeDone;
+		// Frame whose post chain is still to be submitted
+		bool pending = false;
+		uint32_t pendingParity = 0;
+		uint32_t pendingImage = 0;
+		uint32_t pendingFrame = 0;
+#if !defined(TAA_HEADLESS)
+		VkSwapchainKHR pendingSwapChain = VK_NULL_HANDLE;
+#endif
+	} asyncCompute;
+
+	// Passes timed by the profiler, in recording order
+	enum ProfiledPass {
+		PASS_VERTEX_ANIMATION = 0,
+		PASS_BUILDING,
+		PASS_VELOCITY,
+		PASS_VELOCITY_DILATE,
+		PASS_VELOCITY_MAX,
+		PASS_TEMPORAL_REPROJECTION,
+		PASS_QUAD,
+		PASS_COUNT
+	};
+	PassProfiler profiler;
 
+	// Passes of the frame and the images they share, see setupRenderGraph()
+	RenderGraph renderGraph;
+	struct {
+		RenderGraph::Resource color, depth, velocity, dilatedVelocity, velocityReference, tileMax, neighborMax, history;
+	} graphResources;
+
+	// Pipeline cache kept on disk between runs (pipelinecache.hpp). -pipelinecache PATH replaces
+	// the per device file name, -nopipelinecache starts with an empty cache every run and
+	// -pipelinethreads N limits the pipeline creation threads (0: every hardware thread)
+	struct PipelineStartup {
+		bool persistent = true;
+		std::string path;
+		PipelineCacheFile file;
+		uint32_t threads = 0;
+		uint32_t threadsUsed = 0;
+		uint32_t pipelines = 0;
+		double creationMs = 0.0;
+		double startupMs = 0.0;
+		// taa_bench only, preparePipelines() against an empty and against a filled cache
+		double coldMs = 0.0;
+		double warmMs = 0.0;
+	} pipelineStartup;
 
 
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 
@@ -219,45 +528,243 @@ public:
 
 		settings.overlay = true;
 
+		for (size_t i = 0; i < args.size(); i++) {
+			std::string arg = args[i];
+			if (arg == "-computeresolve") {
+				useComputeResolve = true;
+			}
+			if (arg == "-asynccompute") {
+				asyncCompute.enabled = true;
+			}
+			if (arg == "-velocityformat" && i + 1 < args.size()) {
+				std::string format = args[++i];
+				if (format == "rg16f")
+					velocityFormat = VELOCITY_RG16F;
+				else if (format == "rg16snorm")
+					velocityFormat = VELOCITY_RG16_SNORM;
+				else
+					velocityFormat = VELOCITY_RGBA32F;
+			}
+			if (arg == "-velocityprecision") {
+				velocityPrecision.enabled = true;
+			}
+			if (arg == "-velocitypass") {
+				velocityMRT = false;
+			}
+			if (arg == "-framesinflight" && i + 1 < args.size()) {
+				framesInFlight = std::min(std::max(static_cast<uint32_t>(strtol(args[++i], nullptr, 10)), 1u), 3u);
+			}
+			if (arg == "-subpasses") {
+				useSubpasses = true;
+			}
+			if (arg == "-cpureference") {
+				cpuReference.enabled = true;
+			}
+			if (arg == "-renderscale" && i + 1 < args.size()) {
+				renderScale = std::min(std::max(static_cast<float>(atof(args[++i])), 0.5f), 1.0f);
+			}
+			if (arg == "-resolveminmax" && i + 1 < args.size()) {
+				std::string minMax = args[++i];
+				if (minMax == "3x3")
+					resolveVariant.minMax = RESOLVE_MINMAX_3X3;
+				else if (minMax == "4tap")
+					resolveVariant.minMax = RESOLVE_MINMAX_4TAP_VARYING;
+				else
+					resolveVariant.minMax = RESOLVE_MINMAX_3X3_ROUNDED;
+			}
+			if (arg == "-resolvefastclip") {
+				resolveVariant.fastClip = true;
+			}
+			if (arg == "-resolvemotionblur") {
+				resolveVariant.motionBlur = true;
+			}
+			if (arg == "-resolveprecision" && i + 1 < args.size()) {
+				std::string precision = args[++i];
+				if (precision == "fp16")
+					resolvePrecision = RESOLVE_PRECISION_FP16;
+				else if (precision == "fp32")
+					resolvePrecision = RESOLVE_PRECISION_FP32;
+				else
+					resolvePrecision = RESOLVE_PRECISION_AUTO;
+			}
+			if (arg == "-jitter" && i + 1 < args.size()) {
+				JitterPattern pattern;
+				if (jitterPatternFromName(args[++i], pattern))
+					frustumJitter.SetPattern(pattern);
+				else
+					std::cout << "Unknown jitter pattern " << args[i] << ", using " << frustumJitter.sequence.name << std::endl;
+			}
+			if (arg == "-pipelinecache" && i + 1 < args.size()) {
+				pipelineStartup.path = args[++i];
+			}
+			if (arg == "-nopipelinecache") {
+				pipelineStartup.persistent = false;
+			}
+			if (arg == "-pipelinethreads" && i + 1 < args.size()) {
+				pipelineStartup.threads = static_cast<uint32_t>(strtol(args[++i], nullptr, 10));
+			}
+			if (arg == "-mesh" && i + 1 < args.size()) {
+				meshLoad.path = args[++i];
+			}
+			if (arg == "-vertexanimation") {
+				vertexAnimation.enabled = true;
+			}
+			if (arg == "-instances" && i + 1 < args.size()) {
+				instances.count = std::max(static_cast<uint32_t>(strtol(args[++i], nullptr, 10)), 1u);
+			}
+			if (arg == "-dynamicresolution" && i + 1 < args.size()) {
+				dynamicResolution.enabled = true;
+				dynamicResolution.targetMs = std::max(static_cast<float>(atof(args[++i])), 0.1f);
+			}
+		}
+		if (renderScale < 1.0f || dynamicResolution.enabled) {
+			// The compute resolve tiles the color target 1:1 with the history, TaaReference too
+			if (useComputeResolve)
+				std::cout << "-renderscale and -dynamicresolution need the fragment resolve, disabling -computeresolve" << std::endl;
+			if (cpuReference.enabled)
+				std::cout << "-renderscale and -dynamicresolution are not supported by the CPU reference, disabling -cpureference" << std::endl;
+			if (asyncCompute.enabled)
+				std::cout << "-renderscale and -dynamicresolution need the fragment resolve, disabling -asynccompute" << std::endl;
+			useComputeResolve = false;
+			cpuReference.enabled = false;
+			asyncCompute.enabled = false;
+		}
+		if (asyncCompute.enabled) {
+			// Only the compute resolve runs on the compute queue
+			useComputeResolve = true;
+			// Both read the frame back right after its submission, the post chain follows a frame later
+			if (cpuReference.enabled || velocityPrecision.enabled)
+				std::cout << "-asynccompute submits the post chain with the next frame, disabling -cpureference and -velocityprecision" << std::endl;
+			cpuReference.enabled = false;
+			velocityPrecision.enabled = false;
+			// The frame waiting for its post chain holds a fence the next frame must not wait for
+			framesInFlight = std::max(framesInFlight, 2u);
+		}
+		if (cpuReference.enabled && resolveVariantIndex(resolveVariant) != resolveVariantIndex(ResolveVariant())) {
+			// TaaReference implements the default variant
+			std::cout << "-cpureference checks the default resolve variant, ignoring -resolve* options" << std::endl;
+			resolveVariant = ResolveVariant();
+		}
+		if (useComputeResolve && resolveVariantIndex(resolveVariant) != resolveVariantIndex(ResolveVariant())) {
+			// TemprolReprojectionMotion.comp implements the default variant
+			std::cout << "-computeresolve and -asynccompute run the default resolve variant, ignoring -resolve* options" << std::endl;
+			resolveVariant = ResolveVariant();
+		}
+		// Both instances are Vulkan 1.0, querying shaderFloat16 goes through the KHR entry point
+		if (resolvePrecision != RESOLVE_PRECISION_FP32) {
+			uint32_t extensionCount = 0;
+			VK_CHECK_RESULT(vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr));
+			std::vector<VkExtensionProperties> extensions(extensionCount);
+			VK_CHECK_RESULT(vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data()));
+			for (const auto &extension : extensions) {
+				if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+					enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			}
+		}
+#if !defined(TAA_HEADLESS)
+		// The UI is drawn after the quad in the second subpass
+		if (useSubpasses)
+			UIOverlay.subpass = 1;
+#endif
 	}
 
 	~VulkanExample()
 	{
+		// Frames in flight may still reference the resources below
+		vkDeviceWaitIdle(device);
 
 		// Meshes
 		models.scene.destroy();
 		velocity.uniformbuffer.destroy();
-		velocityMax.uniformbuffer.destroy();
 		temproalReproj.uniformbuffer.destroy();
 		building.uniformbuffer.destroy();
+		instances.buffer.destroy();
+
+		for (auto &frame : frameSync)
+		{
+			vkDestroyFence(device, frame.fence, nullptr);
+			vkDestroySemaphore(device, frame.presentComplete, nullptr);
+			vkDestroySemaphore(device, frame.renderComplete, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyPipelineLayout(device, velocity.pipelineLayout, nullptr);
 		vkDestroyPipelineLayout(device, temproalReproj.pipelineLayout, nullptr);
 		vkDestroyPipelineLayout(device, building.pipelineLayout, nullptr);
-		vkDestroyPipelineLayout(device, velocityMax.pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, velocityTiles.pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, velocityDilate.pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, temproalReprojCompute.pipelineLayout, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, velocity.descriptorSetLayout, nullptr);
-		vkDestroyDescriptorSetLayout(device, velocityMax.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, velocityTiles.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, velocityDilate.descriptorSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, temproalReproj.descriptorSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, building.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, temproalReprojCompute.descriptorSetLayout, nullptr);
 
 
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipeline(device, velocity.pipeline, nullptr);
-		vkDestroyPipeline(device, velocityMax.pipeline, nullptr);
-		vkDestroyPipeline(device, building.pipeline, nullptr);
-		vkDestroyPipeline(device, temproalReproj.pipeline, nullptr);
+		destroyPipelines();
+		if (useSubpasses)
+			vkDestroyRenderPass(device, subpassLoadRenderPass, nullptr);
 
 
 		vkDestroyRenderPass(device, velocity.pass.renderPass, nullptr);
-		vkDestroyRenderPass(device, velocityMax.pass.renderPass, nullptr);
 		vkDestroyRenderPass(device, temproalReproj.pass.renderPass, nullptr);
 		vkDestroyRenderPass(device, building.pass.renderPass, nullptr);
 
 		vkDestroySampler(device, colorsampler, nullptr);
 
+		vkDestroyPipelineLayout(device, velocityPrecision.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, velocityPrecision.descriptorSetLayout, nullptr);
+		if (vertexAnimation.enabled)
+		{
+			vkDestroyPipelineLayout(device, vertexAnimation.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, vertexAnimation.descriptorSetLayout, nullptr);
+			for (auto &positions : vertexAnimation.positions)
+				positions.destroy();
+		}
+		if (velocityPrecision.enabled)
+		{
+			vkDestroyRenderPass(device, velocityPrecision.pass.renderPass, nullptr);
+			for (auto framebuffer : velocityPrecision.pass.framebuffers) {
+				vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
+				vkDestroyImage(device, framebuffer.color.image, nullptr);
+				vkDestroyImageView(device, framebuffer.color.view, nullptr);
+			}
+			velocityPrecision.result.destroy();
+		}
+
+		if (cpuReference.enabled)
+		{
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cpuReference.cmdBuffers.size()), cpuReference.cmdBuffers.data());
+			cpuReference.readback.destroy();
+		}
+
+		profiler.destroy();
+
+		for (auto &cmdBuffers : historyCmdBuffers)
+		{
+			if (!cmdBuffers.empty())
+				vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+		}
+
+		if (asyncCompute.enabled)
+		{
+			for (auto &cmdBuffers : asyncCompute.postCmdBuffers)
+			{
+				if (!cmdBuffers.empty())
+					vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+			}
+			// Frees the compute command buffers as well
+			vkDestroyCommandPool(device, asyncCompute.cmdPool, nullptr);
+			for (uint32_t f = 0; f < asyncCompute.graphicsDone.size(); f++)
+			{
+				vkDestroySemaphore(device, asyncCompute.graphicsDone[f], nullptr);
+				vkDestroySemaphore(device, asyncCompute.computeDone[f], nullptr);
+			}
+		}
+
 		for (auto framebuffer : velocity.pass.framebuffers)
 		{
 			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
@@ -268,8 +775,6 @@ public:
 			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
 
 		}
-		for (auto framebuffer : velocityMax.pass.framebuffers)
-			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
 		for (auto framebuffer : temproalReproj.pass.framebuffers)
 			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
 
@@ -278,17 +783,14 @@ public:
 		{
 			vkDestroyImage(device, framebuffer.color.image, nullptr);
 			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
 		}
-		for (auto framebuffer : velocityMax.pass.framebuffers) {
-			vkDestroyImage(device, framebuffer.color.image, nullptr);
-			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
+		for (auto attachment : { velocityDilate.target, velocityTiles.tileMax, velocityTiles.neighborMax }) {
+			vkDestroyImage(device, attachment.image, nullptr);
+			vkDestroyImageView(device, attachment.view, nullptr);
 		}
 		for (auto framebuffer : temproalReproj.pass.framebuffers) {
 			vkDestroyImage(device, framebuffer.color.image, nullptr);
 			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
 		}
 		for (auto framebuffer : building.pass.framebuffers)
 		{
@@ -296,21 +798,37 @@ public:
 			vkDestroyImage(device, framebuffer.color.image, nullptr);
 			vkDestroyImageView(device, framebuffer.depth.view, nullptr);
 			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
-			vkFreeMemory(device, framebuffer.depth.mem, nullptr);
 		}
+		renderTargets.destroy();
 
 
 
 	}
 
 
-	void prepareFramebuffer(OffscreenPass &offscreenPass, VkFormat colorFormat, FrameBuffer &framebuffer, int width, int height)
+	// Framebuffer for a color target created by prepareRenderTargets()
+	void prepareFramebuffer(OffscreenPass &offscreenPass, FrameBuffer &framebuffer, int width, int height)
+	{
+		VkImageView attachments[1];
+		attachments[0] = framebuffer.color.view;
+
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = offscreenPass.renderPass;
+		fbufCreateInfo.attachmentCount = 1;
+		fbufCreateInfo.pAttachments = attachments;
+		fbufCreateInfo.width = width;
+		fbufCreateInfo.height = height;
+		fbufCreateInfo.layers = 1;
+
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &framebuffer.framebuffer));
+	}
+
+	// Image of a render target, bound to memory by renderTargets.allocate()
+	void createRenderTarget(FrameBufferAttachment &target, VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage, uint32_t firstStage, uint32_t lastStage)
 	{
-		// Color attachment
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = colorFormat;
+		image.format = format;
 		image.extent.width = width;
 		image.extent.height = height;
 		image.extent.depth = 1;
@@ -318,55 +836,171 @@ public:
 		image.arrayLayers = 1;
 		image.samples = VK_SAMPLE_COUNT_1_BIT;
 		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		// We will sample directly from the color attachment
-		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = colorFormat;
-		colorImageView.flags = 0;
-		colorImageView.subresourceRange = {};
-		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		colorImageView.subresourceRange.baseMipLevel = 0;
-		colorImageView.subresourceRange.levelCount = 1;
-		colorImageView.subresourceRange.baseArrayLayer = 0;
-		colorImageView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &framebuffer.color.image));
+		image.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &target.image));
+		target.mem = VK_NULL_HANDLE;
+		target.view = VK_NULL_HANDLE;
+		renderTargets.add(vulkanDevice, target.image, firstStage, lastStage);
+	}
 
+	void createRenderTargetView(FrameBufferAttachment &target, VkFormat format, VkImageAspectFlags aspect)
+	{
+		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.subresourceRange = { aspect, 0, 1, 0, 1 };
+		view.image = target.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &target.view));
+	}
 
-		vkGetImageMemoryRequirements(device, framebuffer.color.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &framebuffer.color.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, framebuffer.color.image, framebuffer.color.mem, 0));
+	// Building and velocity targets the frame of the given parity renders into
+	uint32_t inputTarget(uint32_t parity) const
+	{
+		return asyncCompute.enabled ? parity : 0;
+	}
 
-		colorImageView.image = framebuffer.color.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &framebuffer.color.view));
+	// Every render target with the frame stages using it. All images are created before the
+	// arena places them, views and framebuffers need the memory bound.
+	void prepareRenderTargets(VkFormat velocityTargetFormat)
+	{
+		const VkImageUsageFlags sampledAttachment = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		const uint32_t lastInputStage = cpuReference.enabled ? STAGE_READBACK : STAGE_RESOLVE;
+		// With -asynccompute the next frame renders while the compute queue reads them, the
+		// stages of two frames overlap and nothing may share their memory
+		const uint32_t inputTargets = asyncCompute.enabled ? 2 : 1;
+		const uint32_t firstInputStage = asyncCompute.enabled ? RenderTargetArena::PERSISTENT_FIRST : STAGE_BUILDING;
+		const uint32_t lastColorStage = asyncCompute.enabled ? RenderTargetArena::PERSISTENT_LAST : lastInputStage;
+		const uint32_t lastDepthStage = asyncCompute.enabled ? RenderTargetArena::PERSISTENT_LAST : STAGE_RESOLVE;
+		building.pass.framebuffers.resize(inputTargets);
+		velocity.pass.framebuffers.resize(inputTargets);
+		velocityPrecision.pass.framebuffers.resize(velocityPrecision.enabled ? 1 : 0);
+		temproalReproj.pass.framebuffers.resize(2);
+		velocityTiles.width = (renderTargetWidth + VELOCITY_TILE_SIZE - 1) / VELOCITY_TILE_SIZE;
+		velocityTiles.height = (renderTargetHeight + VELOCITY_TILE_SIZE - 1) / VELOCITY_TILE_SIZE;
+
+		for (uint32_t t = 0; t < inputTargets; t++) {
+			FrameBuffer &buildingTarget = building.pass.framebuffers[t];
+			createRenderTarget(buildingTarget.color, VK_FORMAT_R8G8B8A8_UNORM, renderTargetWidth, renderTargetHeight, sampledAttachment | cpuReferenceUsage(), firstInputStage, lastColorStage);
+			createRenderTarget(buildingTarget.depth, BUILDING_DEPTH_FORMAT, renderTargetWidth, renderTargetHeight, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, firstInputStage, lastDepthStage);
+			// Written by the building pass with velocityMRT, by the velocity pass otherwise
+			createRenderTarget(velocity.pass.framebuffers[t].color, velocityTargetFormat, renderTargetWidth, renderTargetHeight, sampledAttachment, firstInputStage, lastColorStage);
+		}
+		// Written and read on the same queue, one target serves both parities
+		createRenderTarget(velocityDilate.target, DILATED_VELOCITY_FORMAT, renderTargetWidth, renderTargetHeight, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | cpuReferenceUsage(), STAGE_VELOCITY_DILATE, lastInputStage);
+		// Dead once compared, the velocity tiles can take its memory
+		for (auto &framebuffer : velocityPrecision.pass.framebuffers)
+			createRenderTarget(framebuffer.color, VK_FORMAT_R32G32B32A32_SFLOAT, renderTargetWidth, renderTargetHeight, sampledAttachment, STAGE_VELOCITY_PRECISION, STAGE_VELOCITY_PRECISION);
+		createRenderTarget(velocityTiles.tileMax, VK_FORMAT_R32G32B32A32_SFLOAT, velocityTiles.width, velocityTiles.height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, STAGE_VELOCITY_TILE_MAX, STAGE_VELOCITY_NEIGHBOR_MAX);
+		createRenderTarget(velocityTiles.neighborMax, VK_FORMAT_R32G32B32A32_SFLOAT, velocityTiles.width, velocityTiles.height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, STAGE_VELOCITY_NEIGHBOR_MAX, STAGE_RESOLVE);
+		// History targets are read by the next frame and also written as storage images by the compute resolve
+		for (auto &framebuffer : temproalReproj.pass.framebuffers)
+			createRenderTarget(framebuffer.color, VK_FORMAT_R8G8B8A8_UNORM, width, height, sampledAttachment | VK_IMAGE_USAGE_STORAGE_BIT | (useSubpasses ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : 0) | cpuReferenceUsage(), RenderTargetArena::PERSISTENT_FIRST, RenderTargetArena::PERSISTENT_LAST);
+
+		renderTargets.allocate();
+
+		for (uint32_t t = 0; t < inputTargets; t++) {
+			createRenderTargetView(building.pass.framebuffers[t].color, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+			createRenderTargetView(building.pass.framebuffers[t].depth, BUILDING_DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+			createRenderTargetView(velocity.pass.framebuffers[t].color, velocityTargetFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		}
+		for (auto &framebuffer : velocityPrecision.pass.framebuffers)
+			createRenderTargetView(framebuffer.color, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+		createRenderTargetView(velocityDilate.target, DILATED_VELOCITY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+		createRenderTargetView(velocityTiles.tileMax, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+		createRenderTargetView(velocityTiles.neighborMax, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+		for (auto &framebuffer : temproalReproj.pass.framebuffers)
+			createRenderTargetView(framebuffer.color, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
 
+	const char *velocityFormatName() const
+	{
+		switch (velocityFormat) {
+		case VELOCITY_RG16F: return "rg16f";
+		case VELOCITY_RG16_SNORM: return "rg16snorm";
+		default: return "rgba32f";
+		}
+	}
 
+	// Picks the velocity target format and encoding scale, R16G16_SNORM is not a
+	// mandatory color attachment format and falls back to R16G16_SFLOAT
+	VkFormat prepareVelocityFormat()
+	{
+		if (velocityFormat == VELOCITY_RG16_SNORM) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R16G16_SNORM, &formatProperties);
+			if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)) {
+				std::cout << "R16G16_SNORM color attachments not supported, using R16G16_SFLOAT velocity" << std::endl;
+				velocityFormat = VELOCITY_RG16F;
+			}
+		}
 
-		VkImageView attachments[1];
-		attachments[0] = framebuffer.color.view;
+		velocityScale = (velocityFormat == VELOCITY_RG16_SNORM) ? VELOCITY_SNORM_SCALE : 1.0f;
+		velocityScaleEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(float));
+		velocityScaleInfo = vks::initializers::specializationInfo(1, &velocityScaleEntry, sizeof(float), &velocityScale);
 
+		switch (velocityFormat) {
+		case VELOCITY_RG16F: return VK_FORMAT_R16G16_SFLOAT;
+		case VELOCITY_RG16_SNORM: return VK_FORMAT_R16G16_SNORM;
+		default: return VK_FORMAT_R32G32B32A32_SFLOAT;
+		}
+	}
 
-		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-		fbufCreateInfo.renderPass = offscreenPass.renderPass;
-		fbufCreateInfo.attachmentCount = 1;
-		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = width;
-		fbufCreateInfo.height = height;
-		fbufCreateInfo.layers = 1;
+	// Enables shaderFloat16 through VK_KHR_shader_float16_int8 when the resolve may use it. Both
+	// bases chain deviceCreatepNextChain into vkCreateDevice
+	virtual void getEnabledFeatures()
+	{
+		if (resolvePrecision == RESOLVE_PRECISION_FP32)
+			return;
+		uint32_t extensionCount = 0;
+		VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr));
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()));
+		bool float16Int8 = false;
+		for (const auto &extension : extensions) {
+			if (strcmp(extension.extensionName, VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME) == 0)
+				float16Int8 = true;
+		}
+		auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		if (!float16Int8 || !getFeatures2)
+			return;
 
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &framebuffer.framebuffer));
+		VkPhysicalDeviceShaderFloat16Int8FeaturesKHR supported{};
+		supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2KHR features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &supported;
+		getFeatures2(physicalDevice, &features2);
+		if (!supported.shaderFloat16)
+			return;
 
+		enabledDeviceExtensions.push_back(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+		float16Int8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+		float16Int8Features.shaderFloat16 = VK_TRUE;
+		deviceCreatepNextChain = &float16Int8Features;
+		shaderFloat16 = true;
+	}
 
+	// The float16_t build only runs with shaderFloat16 enabled, fp32 otherwise
+	void prepareResolvePrecision()
+	{
+		resolveFp16 = resolvePrecision != RESOLVE_PRECISION_FP32 && shaderFloat16;
+		if (resolvePrecision == RESOLVE_PRECISION_FP16 && !resolveFp16)
+			std::cout << "shaderFloat16 is not available, resolving in fp32" << std::endl;
+	}
 
+	void prepareVelocityPrecision()
+	{
+		prepareOffscreenRenderpass(velocityPrecision.pass, VK_FORMAT_R32G32B32A32_SFLOAT, renderTargetWidth, renderTargetHeight, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&velocityPrecision.result,
+			2 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(velocityPrecision.result.map());
 	}
-	void prepareOffscreenRenderpass(OffscreenPass &offscreenPass, VkFormat format, int width, int height, int framebuffercount, VkAttachmentLoadOp op)
+
+	// One framebuffer per color target of offscreenPass.framebuffers, see prepareRenderTargets()
+	void prepareOffscreenRenderpass(OffscreenPass &offscreenPass, VkFormat format, int width, int height, VkAttachmentLoadOp op)
 	{
 		offscreenPass.width = width;
 		offscreenPass.height = height;
@@ -381,8 +1015,9 @@ public:
 		attchmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attchmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attchmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attchmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// The render graph moves the target in and out of the attachment layout
+		attchmentDescription.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attchmentDescription.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 
 		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
@@ -393,222 +1028,781 @@ public:
 		subpassDescription.colorAttachmentCount = 1;
 		subpassDescription.pColorAttachments = &colorReference;
 
+		// No subpass dependencies, the barriers around the pass come from the render graph
+
+		// Create the actual renderpass
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &attchmentDescription;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
+
 
-		// Use subpass dependencies for layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
 
+		for (auto &framebuffer : offscreenPass.framebuffers)
+			prepareFramebuffer(offscreenPass, framebuffer, width, height);
+
+
+
+	}
+
+	// Swapchain render pass of -subpasses: attachment 0 is the swapchain image, attachment 1
+	// the history target, written by subpass 0 and read as input attachment by subpass 1
+	void prepareSubpassRenderPass(VkRenderPass &pass, bool loadHistory)
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		// The quad covers every pixel, nothing needs to be cleared or loaded
+		attachments[0].format = colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+#if defined(TAA_HEADLESS)
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+#else
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+#endif
+		// History target, fully overwritten by the fragment resolve, written by the compute
+		// resolve before the render pass otherwise. The render graph moves it into the
+		// attachment layout, the render pass leaves it ready for the next frame.
+		attachments[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = loadHistory ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference historyReference = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference historyInputReference = { 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+		std::array<VkSubpassDescription, 2> subpassDescriptions = {};
+		// Temporal resolve
+		subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[0].colorAttachmentCount = 1;
+		subpassDescriptions[0].pColorAttachments = &historyReference;
+		// Quad and UI
+		subpassDescriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[1].colorAttachmentCount = 1;
+		subpassDescriptions[1].pColorAttachments = &colorReference;
+		subpassDescriptions[1].inputAttachmentCount = 1;
+		subpassDescriptions[1].pInputAttachments = &historyInputReference;
+
+		std::array<VkSubpassDependency, 3> dependencies;
+
+		// Swapchain image released by the presentation engine, the history target is
+		// synchronized by the render graph
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+		// Resolved pixel read back by the quad at the same position
 		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].dstSubpass = 1;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
 		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-		// Create the actual renderpass
+		// History target sampled by the next frame
+		dependencies[2].srcSubpass = 1;
+		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
 		VkRenderPassCreateInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &attchmentDescription;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+		renderPassInfo.pSubpasses = subpassDescriptions.data();
 		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
-
-
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass));
+	}
 
-		offscreenPass.framebuffers.resize(framebuffercount);
-		// Create two frame buffers
-		for (int i = 0; i < framebuffercount; i++)
-			prepareFramebuffer(offscreenPass, format, offscreenPass.framebuffers[i], width, height);
+	virtual void setupRenderPass()
+	{
+		if (!useSubpasses) {
+			VulkanExampleBase::setupRenderPass();
+			return;
+		}
+		prepareSubpassRenderPass(renderPass, false);
+		prepareSubpassRenderPass(subpassLoadRenderPass, true);
+	}
 
+	virtual void setupFrameBuffer()
+	{
+		if (!useSubpasses) {
+			VulkanExampleBase::setupFrameBuffer();
+			return;
+		}
+		// The history targets do not exist yet when the base prepares, prepare() calls this again
+		if (temproalReproj.pass.framebuffers.empty())
+			return;
+		// Framebuffer of history parity p and swapchain image i at p * imageCount + i
+		frameBuffers.resize(2 * swapChain.imageCount);
+		for (uint32_t parity = 0; parity < 2; parity++)
+		for (uint32_t i = 0; i < swapChain.imageCount; i++)
+		{
+			VkImageView attachments[2];
+			attachments[0] = swapChain.buffers[i].view;
+			attachments[1] = temproalReproj.pass.framebuffers[parity].color.view;
+
+			VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+			frameBufferCreateInfo.renderPass = renderPass;
+			frameBufferCreateInfo.attachmentCount = 2;
+			frameBufferCreateInfo.pAttachments = attachments;
+			frameBufferCreateInfo.width = width;
+			frameBufferCreateInfo.height = height;
+			frameBufferCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[parity * swapChain.imageCount + i]));
+		}
+	}
 
+	// One command buffer per swapchain image from the given pool, false if there already was
+	bool allocateImageCommandBuffers(std::vector<VkCommandBuffer> &cmdBuffers, VkCommandPool pool)
+	{
+		if (cmdBuffers.size() == drawCmdBuffers.size())
+			return false;
+		if (!cmdBuffers.empty())
+			vkFreeCommandBuffers(device, pool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+		cmdBuffers.resize(drawCmdBuffers.size());
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+			vks::initializers::commandBufferAllocateInfo(
+				pool,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				static_cast<uint32_t>(cmdBuffers.size()));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cmdBuffers.data()));
+		return true;
+	}
 
+	// (Re)allocate the per parity command buffers whenever the swapchain image count changes
+	void createHistoryCommandBuffers()
+	{
+		bool reallocated = false;
+		for (uint32_t parity = 0; parity < 2; parity++)
+		{
+			reallocated |= allocateImageCommandBuffers(historyCmdBuffers[parity], cmdPool);
+			if (asyncCompute.enabled) {
+				allocateImageCommandBuffers(asyncCompute.cmdBuffers[parity], asyncCompute.cmdPool);
+				allocateImageCommandBuffers(asyncCompute.postCmdBuffers[parity], cmdPool);
+			}
+		}
+		// One timestamp slot per command buffer
+		if (reallocated)
+		{
+			// Only reached at startup or after the base waited for the device on resize
+			imageFences.assign(drawCmdBuffers.size(), VK_NULL_HANDLE);
+			if (uniformSliceCount != drawCmdBuffers.size())
+			{
+				prepareUniformRings();
+				updateDescriptorSet();
+			}
+			profiler.prepare(vulkanDevice, { "vertexAnimation", "building", "velocity", "velocityDilate", "velocityMax", "temporalReprojection", "quad" }, 2 * static_cast<uint32_t>(drawCmdBuffers.size()));
+			if (asyncCompute.enabled && vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits == 0) {
+				profiler.exclude(PASS_VELOCITY_DILATE);
+				profiler.exclude(PASS_VELOCITY_MAX);
+				profiler.exclude(PASS_TEMPORAL_REPROJECTION);
+			}
+		}
 	}
 
 	void buildCommandBuffers()
 	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		// Command buffers of frames in flight may still be pending
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		if (asyncCompute.enabled)
+			VK_CHECK_RESULT(vkQueueWaitIdle(asyncCompute.queue));
 
+		createHistoryCommandBuffers();
+		setupRenderGraph();
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		// Record one command buffer per swapchain image and history parity, so the
+		// ping-pong between the two TAA history targets only selects what to submit
+		for (int32_t parity = 0; parity < 2; ++parity)
 		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			dynamicResolution.recordedSize[parity].resize(drawCmdBuffers.size());
+			for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 			{
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				VkClearValue clearValues[2];
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
-				renderPassBeginInfo.renderPass = building.pass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-				// Set target frame buffer
-				renderPassBeginInfo.framebuffer =  building.pass.framebuffers[0].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-				VkDeviceSize offsets[1] = { 0 };
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, building.pipeline);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, building.pipelineLayout, 0, 1, &building.descriptorSet, 0, NULL);
-
-				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.scene.vertices.buffer, offsets);
-				vkCmdBindIndexBuffer(drawCmdBuffers[i], models.scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdDrawIndexed(drawCmdBuffers[i], models.scene.indexCount, 1, 0, 0, 0);
-
-				// Display ray traced image generated by compute shader as a full screen quad
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				recordCommandBuffer(parity, i);
 			}
-			{
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				VkClearValue clearValues[1];
-				clearValues[0].color = defaultClearColor;
-				renderPassBeginInfo.renderPass = velocity.pass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-				// Set target frame buffer
-				renderPassBeginInfo.framebuffer = velocity.pass.framebuffers[0].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// Display ray traced image generated by compute shader as a full screen quad
-				// Quad vertices are generated in the vertex shader
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, velocity.pipelineLayout, 0, 1, &velocity.descriptorSet, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, velocity.pipeline);
-				VkDeviceSize offsets[1] = { 0 };
-				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.scene.vertices.buffer, offsets);
-				vkCmdBindIndexBuffer(drawCmdBuffers[i], models.scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdDrawIndexed(drawCmdBuffers[i], models.scene.indexCount, 1, 0, 0, 0);
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-			}
-			{
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				VkClearValue clearValues[1];
-				clearValues[0].color = defaultClearColor;
-				renderPassBeginInfo.renderPass = velocityMax.pass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-				// Set target frame buffer
-				renderPassBeginInfo.framebuffer = velocityMax.pass.framebuffers[0].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// Display ray traced image generated by compute shader as a full screen quad
-				// Quad vertices are generated in the vertex shader
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, velocityMax.pipelineLayout, 0, 1, &velocityMax.descriptorSet, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, velocityMax.pipeline);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+		}
+		if (asyncCompute.pending)
+			flushPendingPost();
+	}
+
+	// The post chain of the last frame, recorded again above, has to run before the next frame
+	// acquires the history on the compute queue. After a swapchain change its image is gone
+	// and only its barriers are submitted.
+	void flushPendingPost()
+	{
+		bool present = true;
+#if !defined(TAA_HEADLESS)
+		present = (asyncCompute.pendingSwapChain == swapChain.swapChain && asyncCompute.pendingImage < drawCmdBuffers.size());
+#endif
+		VkCommandBuffer cmdBuffer;
+		if (present) {
+			cmdBuffer = asyncCompute.postCmdBuffers[asyncCompute.pendingParity][asyncCompute.pendingImage];
+		}
+		else {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cmdBuffer));
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+			renderGraph.record(cmdBuffer, asyncCompute.pendingParity, 0, 2, false);
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		}
+		submitPendingPost(cmdBuffer, VK_NULL_HANDLE, present);
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		if (!present)
+			vkFreeCommandBuffers(device, cmdPool, 1, &cmdBuffer);
+	}
+
+	uint32_t profilerSlot(uint32_t parity, uint32_t i) const
+	{
+		return parity * static_cast<uint32_t>(drawCmdBuffers.size()) + i;
+	}
+
+	// Images shared by the passes of the frame. Their resting layouts are the ones the
+	// descriptor sets sample them in and the ones -cpureference copies them from.
+	void prepareRenderGraph()
+	{
+		if (asyncCompute.enabled) {
+			// One target per parity (inputTarget()), tracked like the history targets
+			graphResources.color = renderGraph.addHistory("color", building.pass.framebuffers[0].color.image, building.pass.framebuffers[1].color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			graphResources.depth = renderGraph.addHistory("depth", building.pass.framebuffers[0].depth.image, building.pass.framebuffers[1].depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			graphResources.velocity = renderGraph.addHistory("velocity", velocity.pass.framebuffers[0].color.image, velocity.pass.framebuffers[1].color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		else {
+			graphResources.color = renderGraph.addImage("color", building.pass.framebuffers[0].color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			graphResources.depth = renderGraph.addImage("depth", building.pass.framebuffers[0].depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			graphResources.velocity = renderGraph.addImage("velocity", velocity.pass.framebuffers[0].color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		graphResources.dilatedVelocity = renderGraph.addImage("dilatedVelocity", velocityDilate.target.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		graphResources.tileMax = renderGraph.addImage("tileMax", velocityTiles.tileMax.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		graphResources.neighborMax = renderGraph.addImage("neighborMax", velocityTiles.neighborMax.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		graphResources.history = renderGraph.addHistory("history", temproalReproj.pass.framebuffers[0].color.image, temproalReproj.pass.framebuffers[1].color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		if (velocityPrecision.enabled) {
+			graphResources.velocityReference = renderGraph.addImage("velocityReference", velocityPrecision.pass.framebuffers[0].color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			// The velocity tiles may take the memory of the reference (prepareRenderTargets)
+			for (auto tiles : { graphResources.tileMax, graphResources.neighborMax }) {
+				if (renderTargets.aliases(renderGraph.image(tiles, RenderGraph::CURRENT, 0), velocityPrecision.pass.framebuffers[0].color.image))
+					renderGraph.alias(tiles, graphResources.velocityReference);
 			}
+		}
+
+		// Nothing has been rendered yet, the first frame runs with zero feedback
+		// (see updateTemproalUniformBuffers) so the undefined history never reaches the output.
+		// The entry states and the queues they are on come from the compiled passes.
+		setupRenderGraph();
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		renderGraph.initialize(layoutCmd);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+	}
+
+	// Declares the passes of the current settings with everything they read and write, the
+	// graph adds the barriers between them. The velocity tiles are culled unless the resolve
+	// reads them, only the fragment resolve with motion blur does. With -asynccompute the
+	// post chain up to the resolve runs on the compute queue.
+	void setupRenderGraph()
+	{
+		const VkPipelineStageFlags colorOutput = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		const VkPipelineStageFlags depthTests = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		const VkPipelineStageFlags fragment = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		const VkAccessFlags depthAttachment = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		const VkImageLayout attachment = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		const VkImageLayout sampled = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		const VkImageLayout depthSampled = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		const auto &r = graphResources;
+
+		renderGraph.clearPasses();
+
+		if (vertexAnimation.enabled) {
+			renderGraph.addPass("vertexAnimation", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordVertexAnimationPass(cmdBuffer, parity, i); })
+				.output();
+		}
+
+		RenderGraph::Pass &buildingPass = renderGraph.addPass("building", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordBuildingPass(cmdBuffer, parity, i); });
+		buildingPass.write(r.color, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, true);
+		buildingPass.write(r.depth, depthTests, depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true);
+		if (velocityMRT)
+			buildingPass.write(r.velocity, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, true);
+
+		if (!velocityMRT) {
+			renderGraph.addPass("velocity", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordVelocityPass(cmdBuffer, parity, i); })
+				.read(r.depth, fragment, VK_ACCESS_SHADER_READ_BIT, depthSampled)
+				.write(r.velocity, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, true);
+		}
+
+		RenderGraph::Pass &dilatePass = renderGraph.addPass("velocityDilate", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordVelocityDilatePass(cmdBuffer, parity, i); })
+			.read(r.depth, compute, VK_ACCESS_SHADER_READ_BIT, depthSampled)
+			.read(r.velocity, compute, VK_ACCESS_SHADER_READ_BIT, sampled)
+			.write(r.dilatedVelocity, compute, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+		if (asyncCompute.enabled)
+			dilatePass.async();
+
+		if (velocityPrecision.enabled) {
+			renderGraph.addPass("velocityReference", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordVelocityReferencePass(cmdBuffer, parity, i); })
+				.read(r.depth, fragment, VK_ACCESS_SHADER_READ_BIT, depthSampled)
+				.write(r.velocityReference, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, true);
+			// Read back by the host
+			renderGraph.addPass("velocityCompare", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordVelocityComparePass(cmdBuffer, parity, i); })
+				.read(r.velocity, compute, VK_ACCESS_SHADER_READ_BIT, sampled)
+				.read(r.velocityReference, compute, VK_ACCESS_SHADER_READ_BIT, sampled)
+				.output();
+		}
+
+		// Both dispatches are timed as one pass, begun by tileMax and ended by neighborMax
+		RenderGraph::Pass &tileMaxPass = renderGraph.addPass("tileMax", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordTileMaxPass(cmdBuffer, parity, i); })
+			.read(r.velocity, compute, VK_ACCESS_SHADER_READ_BIT, sampled)
+			.write(r.tileMax, compute, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, false);
+		if (asyncCompute.enabled)
+			tileMaxPass.async();
+		RenderGraph::Pass &neighborMaxPass = renderGraph.addPass("neighborMax", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordNeighborMaxPass(cmdBuffer, parity, i); })
+			.read(r.tileMax, compute, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL)
+			.write(r.neighborMax, compute, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, false);
+		if (asyncCompute.enabled)
+			neighborMaxPass.async();
+
+		const VkPipelineStageFlags resolveStage = useComputeResolve ? compute : fragment;
+		RenderGraph::Pass *resolvePass;
+		if (useComputeResolve) {
+			resolvePass = &renderGraph.addPass("temporalReprojection", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordComputeResolvePass(cmdBuffer, parity, i); })
+				.write(r.history, compute, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+			if (asyncCompute.enabled)
+				resolvePass->async();
+		}
+		else if (useSubpasses) {
+			// Resolve and quad in one render pass, which leaves the history target ready for sampling
+			resolvePass = &renderGraph.addPass("temporalReprojection", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordSubpassesPass(cmdBuffer, parity, i); })
+				.write(r.history, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, true, sampled)
+				.output();
+		}
+		else {
+			resolvePass = &renderGraph.addPass("temporalReprojection", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordResolvePass(cmdBuffer, parity, i); })
+				.write(r.history, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, true);
+		}
+		resolvePass->read(r.color, resolveStage, VK_ACCESS_SHADER_READ_BIT, sampled)
+			.read(r.dilatedVelocity, resolveStage, VK_ACCESS_SHADER_READ_BIT, sampled)
+			.read(r.history, resolveStage, VK_ACCESS_SHADER_READ_BIT, sampled, RenderGraph::PREVIOUS);
+		if (!useComputeResolve && resolveVariant.motionBlur)
+			resolvePass->read(r.neighborMax, fragment, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+
+		if (useComputeResolve && useSubpasses) {
+			// Loads the history target into the empty resolve subpass
+			renderGraph.addPass("quad", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordSubpassesPass(cmdBuffer, parity, i); })
+				.write(r.history, colorOutput, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, attachment, false, sampled)
+				.output();
+		}
+		else if (!useSubpasses) {
+			renderGraph.addPass("quad", [this](VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i) { recordQuadPass(cmdBuffer, parity, i); })
+				.read(r.history, fragment, VK_ACCESS_SHADER_READ_BIT, sampled)
+				.output();
+		}
+
+		renderGraph.compile();
+	}
+
+	// The render size is baked into viewports and dispatches, -dynamicresolution re-records
+	// single command buffers once their previous submission is done (see draw())
+	void recordCommandBuffer(int32_t parity, int32_t i)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		if (asyncCompute.enabled) {
+			// Geometry, post chain on the compute queue, quad
+			assert(renderGraph.segmentCount() == 3);
+			const VkCommandBuffer segmentCmdBuffers[3] = { historyCmdBuffers[parity][i], asyncCompute.cmdBuffers[parity][i], asyncCompute.postCmdBuffers[parity][i] };
+			for (uint32_t segment = 0; segment < 3; segment++)
 			{
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				VkClearValue clearValues[1];
-				clearValues[0].color = defaultClearColor;
-				renderPassBeginInfo.renderPass = temproalReproj.pass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-				// Set target frame buffer
-				renderPassBeginInfo.framebuffer = temproalReproj.pass.framebuffers[current].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, temproalReproj.pipelineLayout, 0, 1, &temproalReproj.descriptorSet, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, temproalReproj.pipeline);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				VK_CHECK_RESULT(vkBeginCommandBuffer(segmentCmdBuffers[segment], &cmdBufInfo));
+				if (segment == 0)
+					profiler.reset(segmentCmdBuffers[segment], profilerSlot(parity, i));
+				renderGraph.record(segmentCmdBuffers[segment], parity, i, segment);
+				VK_CHECK_RESULT(vkEndCommandBuffer(segmentCmdBuffers[segment]));
 			}
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
+		}
+		else {
+			VkCommandBuffer cmdBuffer = historyCmdBuffers[parity][i];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+			profiler.reset(cmdBuffer, profilerSlot(parity, i));
+			renderGraph.record(cmdBuffer, parity, i);
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		}
+		dynamicResolution.recordedSize[parity][i] = { renderWidth, renderHeight };
+	}
 
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
+	// The position buffers are not tracked by the render graph, their barriers stay here
+	void recordVertexAnimationPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		// positions[parity] was the previous position stream of the last frame
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			0, nullptr);
+
+		const uint32_t velocityOffset = static_cast<uint32_t>(i * velocity.uniformStride);
+		const uint32_t vertexFormat[2] = { models.scene.vertexCount, MeshFile::stride(MeshFile::sceneStreams()[0]) / static_cast<uint32_t>(sizeof(float)) };
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_VERTEX_ANIMATION);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vertexAnimation.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vertexAnimation.pipelineLayout, 0, 1, &vertexAnimation.descriptorSets[parity], 1, &velocityOffset);
+		vkCmdPushConstants(cmdBuffer, vertexAnimation.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vertexFormat), vertexFormat);
+		vkCmdDispatch(cmdBuffer, (models.scene.vertexCount + 63) / 64, 1, 1);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_VERTEX_ANIMATION);
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
 
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
+	// Binding 0 holds the positions, with -vertexanimation the pre-pass stream of this frame and
+	// binding 1 the one of the last frame. Binding 2, the packed attributes, only when shading.
+	void bindSceneGeometry(VkCommandBuffer cmdBuffer, uint32_t parity, bool attributes)
+	{
+		const VkDeviceSize offsets[2] = { 0, 0 };
+		if (vertexAnimation.enabled) {
+			const VkBuffer buffers[2] = { vertexAnimation.positions[parity].buffer, vertexAnimation.positions[1 - parity].buffer };
+			vkCmdBindVertexBuffers(cmdBuffer, 0, 2, buffers, offsets);
+		}
+		else {
+			vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.scene.positions.buffer, offsets);
+		}
+		if (attributes) {
+			vkCmdBindVertexBuffers(cmdBuffer, 2, 1, &models.scene.attributes.buffer, offsets);
+		}
+		vkCmdBindIndexBuffer(cmdBuffer, models.scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
 
+	void recordBuildingPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		// Uniform buffer slice of this swapchain image
+		const uint32_t buildingOffsets[3] = { static_cast<uint32_t>(i * building.uniformStride), static_cast<uint32_t>(i * velocity.uniformStride), static_cast<uint32_t>(i * instances.stride) };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		VkClearValue clearValues[3];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		renderPassBeginInfo.renderPass = building.pass.renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = renderWidth;
+		renderPassBeginInfo.renderArea.extent.height = renderHeight;
+		renderPassBeginInfo.clearValueCount = velocityMRT ? 3 : 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer =  building.pass.framebuffers[inputTarget(parity)].framebuffer;
+
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_BUILDING);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)renderWidth, (float)renderHeight, 0.0f, 1.0f);
+
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(renderWidth, renderHeight, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, building.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, building.pipelineLayout, 0, 1, &building.descriptorSet, 3, buildingOffsets);
+
+		bindSceneGeometry(cmdBuffer, parity, true);
+		vkCmdDrawIndexed(cmdBuffer, models.scene.indexCount, instances.count, 0, 0, 0);
+
+		vkCmdEndRenderPass(cmdBuffer);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_BUILDING);
+	}
 
+	void recordVelocityPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		const uint32_t velocityOffsets[2] = { static_cast<uint32_t>(i * velocity.uniformStride), static_cast<uint32_t>(i * instances.stride) };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		VkClearValue clearValues[1];
+		// No geometry means no motion, in every encoding
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		renderPassBeginInfo.renderPass = velocity.pass.renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = renderWidth;
+		renderPassBeginInfo.renderArea.extent.height = renderHeight;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = velocity.pass.framebuffers[inputTarget(parity)].framebuffer;
+
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_VELOCITY);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)renderWidth, (float)renderHeight, 0.0f, 1.0f);
+
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(renderWidth, renderHeight, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, velocity.pipelineLayout, 0, 1, &velocityDescriptorSets[parity], 2, velocityOffsets);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, velocity.pipeline);
+		bindSceneGeometry(cmdBuffer, parity, false);
+		vkCmdDrawIndexed(cmdBuffer, models.scene.indexCount, instances.count, 0, 0, 0);
+		vkCmdEndRenderPass(cmdBuffer);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_VELOCITY);
+	}
 
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	void recordVelocityDilatePass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_VELOCITY_DILATE);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityDilate.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityDilate.pipelineLayout, 0, 1, &velocityDilate.descriptorSets[parity], 0, NULL);
+		// Only the pixels inside the viewport of the building pass, the resolve never reads past it
+		const int32_t renderSize[2] = { static_cast<int32_t>(renderWidth), static_cast<int32_t>(renderHeight) };
+		vkCmdPushConstants(cmdBuffer, velocityDilate.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(renderSize), renderSize);
+		vkCmdDispatch(cmdBuffer, (renderWidth + VELOCITY_DILATE_GROUP_SIZE - 1) / VELOCITY_DILATE_GROUP_SIZE, (renderHeight + VELOCITY_DILATE_GROUP_SIZE - 1) / VELOCITY_DILATE_GROUP_SIZE, 1);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_VELOCITY_DILATE);
+	}
 
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+	// Same draw into the fp32 reference, not part of the timed passes
+	void recordVelocityReferencePass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		const uint32_t velocityOffsets[2] = { static_cast<uint32_t>(i * velocity.uniformStride), static_cast<uint32_t>(i * instances.stride) };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		VkClearValue clearValues[1];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		renderPassBeginInfo.renderPass = velocityPrecision.pass.renderPass;
+		renderPassBeginInfo.renderArea.extent.width = renderWidth;
+		renderPassBeginInfo.renderArea.extent.height = renderHeight;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = velocityPrecision.pass.framebuffers[0].framebuffer;
+
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)renderWidth, (float)renderHeight, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(renderWidth, renderHeight, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, velocity.pipelineLayout, 0, 1, &velocityDescriptorSets[parity], 2, velocityOffsets);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, velocityPrecision.pipeline);
+		bindSceneGeometry(cmdBuffer, parity, false);
+		vkCmdDrawIndexed(cmdBuffer, models.scene.indexCount, instances.count, 0, 0, 0);
+		vkCmdEndRenderPass(cmdBuffer);
+	}
 
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+	// The result buffer is not tracked by the render graph, its barriers stay here
+	void recordVelocityComparePass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		vkCmdFillBuffer(cmdBuffer, velocityPrecision.result.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityPrecision.comparePipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityPrecision.pipelineLayout, 0, 1, &velocityPrecision.descriptorSet, 0, NULL);
+		vkCmdDispatch(cmdBuffer, (renderWidth + 15) / 16, (renderHeight + 15) / 16, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
 
-				// Display ray traced image generated by compute shader as a full screen quad
-				// Quad vertices are generated in the vertex shader
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+	void recordTileMaxPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_VELOCITY_MAX);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityTiles.tileMaxPipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityTiles.pipelineLayout, 0, 1, &velocityTiles.tileMaxDescriptorSets[parity], 0, NULL);
+		// Only the tiles covering the viewport of the building pass
+		const int32_t renderTiles[4] = {
+			static_cast<int32_t>(renderWidth), static_cast<int32_t>(renderHeight),
+			static_cast<int32_t>((renderWidth + VELOCITY_TILE_SIZE - 1) / VELOCITY_TILE_SIZE),
+			static_cast<int32_t>((renderHeight + VELOCITY_TILE_SIZE - 1) / VELOCITY_TILE_SIZE) };
+		vkCmdPushConstants(cmdBuffer, velocityTiles.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(renderTiles), renderTiles);
+		vkCmdDispatch(cmdBuffer, renderTiles[2], renderTiles[3], 1);
+	}
 
-				//drawUI(drawCmdBuffers[i]);
+	void recordNeighborMaxPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		const uint32_t tilesX = (renderWidth + VELOCITY_TILE_SIZE - 1) / VELOCITY_TILE_SIZE;
+		const uint32_t tilesY = (renderHeight + VELOCITY_TILE_SIZE - 1) / VELOCITY_TILE_SIZE;
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityTiles.neighborMaxPipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, velocityTiles.pipelineLayout, 0, 1, &velocityTiles.neighborMaxDescriptorSet, 0, NULL);
+		vkCmdDispatch(
+			cmdBuffer,
+			(tilesX + VELOCITY_NEIGHBOR_GROUP_SIZE - 1) / VELOCITY_NEIGHBOR_GROUP_SIZE,
+			(tilesY + VELOCITY_NEIGHBOR_GROUP_SIZE - 1) / VELOCITY_NEIGHBOR_GROUP_SIZE,
+			1);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_VELOCITY_MAX);
+	}
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-			}
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+	void recordResolvePass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		const uint32_t temproalReprojOffset = static_cast<uint32_t>(i * temproalReproj.uniformStride);
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		VkClearValue clearValues[1];
+		clearValues[0].color = defaultClearColor;
+		renderPassBeginInfo.renderPass = temproalReproj.pass.renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = temproalReproj.pass.framebuffers[parity].framebuffer;
+
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_TEMPORAL_REPROJECTION);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, temproalReproj.pipelineLayout, 0, 1, &historyDescriptorSets[parity], 1, &temproalReprojOffset);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, temproalReproj.pipeline);
+		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+		vkCmdEndRenderPass(cmdBuffer);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_TEMPORAL_REPROJECTION);
+	}
+
+	// Writes the history target as storage image in GENERAL layout
+	void recordComputeResolvePass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		const uint32_t temproalReprojOffset = static_cast<uint32_t>(i * temproalReproj.uniformStride);
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_TEMPORAL_REPROJECTION);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, temproalReprojCompute.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, temproalReprojCompute.pipelineLayout, 0, 1, &temproalReprojCompute.descriptorSets[parity], 1, &temproalReprojOffset);
+		vkCmdDispatch(cmdBuffer, (width + RESOLVE_TILE_SIZE - 1) / RESOLVE_TILE_SIZE, (height + RESOLVE_TILE_SIZE - 1) / RESOLVE_TILE_SIZE, 1);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_TEMPORAL_REPROJECTION);
+	}
+
+	// -subpasses: resolve and quad in the swapchain render pass
+	void recordSubpassesPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		const uint32_t slot = profilerSlot(parity, i);
+		const uint32_t temproalReprojOffset = static_cast<uint32_t>(i * temproalReproj.uniformStride);
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = useComputeResolve ? subpassLoadRenderPass : renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 0;
+		renderPassBeginInfo.framebuffer = frameBuffers[parity * drawCmdBuffers.size() + i];
+
+		if (!useComputeResolve)
+			profiler.begin(cmdBuffer, slot, PASS_TEMPORAL_REPROJECTION);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		// Subpass 0 stays empty when the compute resolve has already written the history target
+		if (!useComputeResolve) {
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, temproalReproj.pipelineLayout, 0, 1, &historyDescriptorSets[parity], 1, &temproalReprojOffset);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, temproalReproj.pipeline);
+			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+			profiler.end(cmdBuffer, slot, PASS_TEMPORAL_REPROJECTION);
 		}
+
+		vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		profiler.begin(cmdBuffer, slot, PASS_QUAD);
+
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &quadDescriptorSets[parity], 0, NULL);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+
+		drawUI(cmdBuffer);
+
+		vkCmdEndRenderPass(cmdBuffer);
+		profiler.end(cmdBuffer, slot, PASS_QUAD);
+	}
+
+	void recordQuadPass(VkCommandBuffer cmdBuffer, uint32_t parity, uint32_t i)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		renderPassBeginInfo.framebuffer = frameBuffers[i];
+
+		profiler.begin(cmdBuffer, profilerSlot(parity, i), PASS_QUAD);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		// Quad vertices are generated in the vertex shader
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &quadDescriptorSets[parity], 0, NULL);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+
+		drawUI(cmdBuffer);
+
+		vkCmdEndRenderPass(cmdBuffer);
+		profiler.end(cmdBuffer, profilerSlot(parity, i), PASS_QUAD);
 	}
 
+	// Collects every pipeline and creates them on pipelineStartup.threads worker threads
 	void preparePipelines()
 	{
+		PipelineBatch pipelines;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -620,17 +1814,26 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
-		// Vertex input state for scene rendering
-		const std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
-			vks::initializers::vertexInputBindingDescription(0, vertexLayout.stride(), VK_VERTEX_INPUT_RATE_VERTEX),
+		// Vertex input state for scene rendering, see bindSceneGeometry(). With -vertexanimation
+		// the positions of this and the last frame come from the pre-pass streams, otherwise both
+		// are the model's positions. The velocity pass only reads the positions.
+		const uint32_t positionStride = MeshFile::stride(MeshFile::sceneStreams()[0]);
+		std::vector<VkVertexInputBindingDescription> positionInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, positionStride, VK_VERTEX_INPUT_RATE_VERTEX),
 		};
-
-		// Attribute descriptions
-		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+		if (vertexAnimation.enabled) {
+			positionInputBindings.push_back(vks::initializers::vertexInputBindingDescription(1, positionStride, VK_VERTEX_INPUT_RATE_VERTEX));
+		}
+		const uint32_t prevPositionBinding = vertexAnimation.enabled ? 1 : 0;
+		std::vector<VkVertexInputAttributeDescription> positionInputAttributes = {
 			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),					// Position
-			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3),	// Normal
-			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 6),		// UV
+			vks::initializers::vertexInputAttributeDescription(prevPositionBinding, 3, VK_FORMAT_R32G32B32_SFLOAT, 0),	// Position of the last frame
 		};
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = positionInputBindings;
+		vertexInputBindings.push_back(vks::initializers::vertexInputBindingDescription(2, MeshFile::stride(MeshFile::sceneStreams()[1]), VK_VERTEX_INPUT_RATE_VERTEX));
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = positionInputAttributes;
+		vertexInputAttributes.push_back(vks::initializers::vertexInputAttributeDescription(2, 1, VK_FORMAT_R16G16_SNORM, 0));				// Normal, octahedral
+		vertexInputAttributes.push_back(vks::initializers::vertexInputAttributeDescription(2, 2, VK_FORMAT_R16G16_SFLOAT, sizeof(uint16_t) * 2));	// UV
 
 		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputBindings.size());
@@ -638,6 +1841,12 @@ public:
 		vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
 		vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
+		VkPipelineVertexInputStateCreateInfo positionInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		positionInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(positionInputBindings.size());
+		positionInputState.pVertexBindingDescriptions = positionInputBindings.data();
+		positionInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(positionInputAttributes.size());
+		positionInputState.pVertexAttributeDescriptions = positionInputAttributes.data();
+
 		// Empty vertex input state for fullscreen passes
 		VkPipelineVertexInputStateCreateInfo emptyVertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 
@@ -653,117 +1862,670 @@ public:
 		pipelineCreateInfo.pDynamicState = &dynamicState;
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCreateInfo.pStages = shaderStages.data();
+		// Color and velocity attachments, kept alive until the batch is created
+		std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = { blendAttachmentState, blendAttachmentState };
+		VkPipelineColorBlendStateCreateInfo mrtColorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(blendAttachmentStates.size()), blendAttachmentStates.data());
 		// Solid rendering pipeline
-		shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &building.pipeline));
+		if (velocityMRT) {
+			pipelineCreateInfo.pColorBlendState = &mrtColorBlendState;
+			shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/sceneVelocity.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/sceneVelocity.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1].pSpecializationInfo = &velocityScaleInfo;
+			pipelines.add(pipelineCreateInfo, &building.pipeline);
+			pipelineCreateInfo.pColorBlendState = &colorBlendState;
+		}
+		else {
+			shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			pipelines.add(pipelineCreateInfo, &building.pipeline);
+		}
 
 		pipelineCreateInfo.renderPass = velocity.pass.renderPass;
 		pipelineCreateInfo.layout = velocity.pipelineLayout;
+		pipelineCreateInfo.pVertexInputState = &positionInputState;
 		// Solid rendering pipeline
 		shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/velocityMotion.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/velocityMotion.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = &velocityScaleInfo;
+
+		pipelines.add(pipelineCreateInfo, &velocity.pipeline);
+
+		if (velocityPrecision.enabled) {
+			// fp32 reference keeps the default VELOCITY_SCALE of 1
+			shaderStages[1].pSpecializationInfo = nullptr;
+			pipelineCreateInfo.renderPass = velocityPrecision.pass.renderPass;
+			pipelines.add(pipelineCreateInfo, &velocityPrecision.pipeline);
+		}
+
+		pipelineCreateInfo.pVertexInputState = &emptyVertexInputState;
+		pipelineCreateInfo.layout = temproalReproj.pipelineLayout;
+		// First subpass of the swapchain render pass with -subpasses
+		pipelineCreateInfo.renderPass = useSubpasses ? renderPass : temproalReproj.pass.renderPass;
+
+		// One pipeline per resolve variant, sharing the shader modules
+		const std::string resolvePrecisionSuffix = resolveFp16 ? "Fp16" : "";
+		shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/velocity.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/TemprolReprojection" + resolvePrecisionSuffix + ".frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		struct ResolveConstants {
+			float velocityScale;
+			VkBool32 fastClip;
+			int32_t minMax;
+			VkBool32 motionBlur;
+		};
+		const std::array<VkSpecializationMapEntry, 4> resolveEntries = {
+			vks::initializers::specializationMapEntry(0, offsetof(ResolveConstants, velocityScale), sizeof(float)),
+			vks::initializers::specializationMapEntry(1, offsetof(ResolveConstants, fastClip), sizeof(VkBool32)),
+			vks::initializers::specializationMapEntry(2, offsetof(ResolveConstants, minMax), sizeof(int32_t)),
+			vks::initializers::specializationMapEntry(3, offsetof(ResolveConstants, motionBlur), sizeof(VkBool32))
+		};
+		resolvePipelines.resize(RESOLVE_MINMAX_COUNT * 2 * 2);
+		for (int32_t minMax = 0; minMax < RESOLVE_MINMAX_COUNT; minMax++)
+		for (int32_t fastClip = 0; fastClip < 2; fastClip++)
+		for (int32_t motionBlur = 0; motionBlur < 2; motionBlur++)
+		{
+			ResolveVariant variant;
+			variant.fastClip = (fastClip == 1);
+			variant.minMax = minMax;
+			variant.motionBlur = (motionBlur == 1);
+			const ResolveConstants constants = { velocityScale, static_cast<VkBool32>(fastClip), minMax, static_cast<VkBool32>(motionBlur) };
+			VkSpecializationInfo resolveInfo = vks::initializers::specializationInfo(static_cast<uint32_t>(resolveEntries.size()), resolveEntries.data(), sizeof(constants), &constants);
+			shaderStages[1].pSpecializationInfo = &resolveInfo;
+			pipelines.add(pipelineCreateInfo, &resolvePipelines[resolveVariantIndex(variant)]);
+		}
+		shaderStages[1].pSpecializationInfo = nullptr;
+
+		pipelineCreateInfo.renderPass = renderPass;
+		pipelineCreateInfo.layout = pipelineLayout;
+		// Solid rendering pipeline
+	//	shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/velocity.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		if (useSubpasses) {
+			pipelineCreateInfo.subpass = 1;
+			shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/quadInput.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		}
+		else {
+			shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/quad.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		}
+		pipelines.add(pipelineCreateInfo, &pipeline);
+		pipelineCreateInfo.subpass = 0;
+
+		// Compute resolve
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(temproalReprojCompute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/scenerendering/TemprolReprojectionMotion" + resolvePrecisionSuffix + ".comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		pipelines.add(computePipelineCreateInfo, &temproalReprojCompute.pipeline);
+
+		// Closest depth dilation, decodes the velocity target
+		computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(velocityDilate.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/scenerendering/velocityDilate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &velocityScaleInfo;
+		pipelines.add(computePipelineCreateInfo, &velocityDilate.pipeline);
+
+		// Velocity tile reduction
+		computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(velocityTiles.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/scenerendering/velocityTileMax.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		pipelines.add(computePipelineCreateInfo, &velocityTiles.tileMaxPipeline);
+		computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/scenerendering/velocityNeighborMax.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		pipelines.add(computePipelineCreateInfo, &velocityTiles.neighborMaxPipeline);
+
+		if (velocityPrecision.enabled) {
+			computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(velocityPrecision.pipelineLayout, 0);
+			computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/scenerendering/velocityCompare.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &velocityScaleInfo;
+			pipelines.add(computePipelineCreateInfo, &velocityPrecision.comparePipeline);
+		}
+
+		if (vertexAnimation.enabled) {
+			computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(vertexAnimation.pipelineLayout, 0);
+			computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/scenerendering/vertexAnimation.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			pipelines.add(computePipelineCreateInfo, &vertexAnimation.pipeline);
+		}
+
+		pipelineStartup.pipelines = pipelines.size();
+		pipelines.create(device, pipelineCache, pipelineStartup.threads);
+		pipelineStartup.threadsUsed = pipelines.threads();
+		temproalReproj.pipeline = resolvePipelines[resolveVariantIndex(resolveVariant)];
+	}
+
+	void destroyPipelines()
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, velocity.pipeline, nullptr);
+		vkDestroyPipeline(device, velocityTiles.tileMaxPipeline, nullptr);
+		vkDestroyPipeline(device, velocityTiles.neighborMaxPipeline, nullptr);
+		vkDestroyPipeline(device, velocityDilate.pipeline, nullptr);
+		vkDestroyPipeline(device, building.pipeline, nullptr);
+		for (auto resolvePipeline : resolvePipelines)
+			vkDestroyPipeline(device, resolvePipeline, nullptr);
+		vkDestroyPipeline(device, temproalReprojCompute.pipeline, nullptr);
+		if (velocityPrecision.enabled) {
+			vkDestroyPipeline(device, velocityPrecision.pipeline, nullptr);
+			vkDestroyPipeline(device, velocityPrecision.comparePipeline, nullptr);
+		}
+		if (vertexAnimation.enabled)
+			vkDestroyPipeline(device, vertexAnimation.pipeline, nullptr);
+	}
+
+#if defined(TAA_HEADLESS)
+	// Times preparePipelines() against an empty cache and against one holding the results of
+	// that run. Drivers with their own shader cache (Mesa) need it disabled for a cold number.
+	void measurePipelineStartup()
+	{
+		VkPipelineCache persistentCache = pipelineCache;
+		std::vector<uint8_t> empty;
+		for (double *result : { &pipelineStartup.coldMs, &pipelineStartup.warmMs })
+		{
+			pipelineCache = PipelineCacheFile::create(device, (result == &pipelineStartup.coldMs) ? empty : PipelineCacheFile::data(device, persistentCache));
+			destroyPipelines();
+			auto tStart = std::chrono::high_resolution_clock::now();
+			preparePipelines();
+			*result = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			vkDestroyPipelineCache(device, pipelineCache, nullptr);
+		}
+		pipelineCache = persistentCache;
+	}
+#endif
+
+	static uint32_t resolveVariantIndex(const ResolveVariant &variant)
+	{
+		return (static_cast<uint32_t>(variant.minMax) * 2 + (variant.fastClip ? 1 : 0)) * 2 + (variant.motionBlur ? 1 : 0);
+	}
+
+	// The compute resolve always runs the default variant
+	ResolveVariant activeResolveVariant() const
+	{
+		return useComputeResolve ? ResolveVariant() : resolveVariant;
+	}
+
+	static const char *resolveMinMaxName(int32_t minMax)
+	{
+		switch (minMax) {
+		case RESOLVE_MINMAX_3X3: return "3x3";
+		case RESOLVE_MINMAX_4TAP_VARYING: return "4tap";
+		default: return "rounded";
+		}
+	}
+
+	void updateUniformBuffers()
+	{
+
+
+		uboSceneMatrices.projection = camera.matrices.perspective;
+		uboSceneMatrices.view = camera.matrices.view;
+		memcpy(static_cast<char*>(building.uniformbuffer.mapped) + uniformSlice * building.uniformStride, &uboSceneMatrices, sizeof(uboSceneMatrices));
+
+	}
+
+	// Picks the render scale for the next frame from the GPU time of the finished ones
+	void updateDynamicResolution()
+	{
+		DynamicResolution &dr = dynamicResolution;
+		if (profiler.collectedFrames() == dr.collectedFrames)
+			return;
+		dr.collectedFrames = profiler.collectedFrames();
+		if (dr.settleFrames > 0) {
+			dr.settleFrames--;
+			return;
+		}
+		const float frameMs = profiler.lastFrameMs();
+		dr.averageMs = (dr.averageMs == 0.0f) ? frameMs : dr.averageMs + 0.1f * (frameMs - dr.averageMs);
+
+		// GPU time follows the pixel count, the square of the scale. Drop straight to the scale
+		// that fits the target, raise one step at a time after a run of frames with headroom
+		float scale = dr.scale;
+		if (dr.averageMs > dr.targetMs) {
+			dr.headroomFrames = 0;
+			scale = dr.scale * sqrtf(DYNAMIC_RESOLUTION_HEADROOM * dr.targetMs / dr.averageMs);
+			scale = std::min(floorf(scale / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP, dr.scale - DYNAMIC_RESOLUTION_STEP);
+		}
+		else if (dr.averageMs < DYNAMIC_RESOLUTION_HEADROOM * dr.targetMs) {
+			if (++dr.headroomFrames >= DYNAMIC_RESOLUTION_RAISE_FRAMES) {
+				dr.headroomFrames = 0;
+				scale = dr.scale + DYNAMIC_RESOLUTION_STEP;
+			}
+		}
+		else {
+			dr.headroomFrames = 0;
+		}
+		scale = std::min(std::max(scale, DYNAMIC_RESOLUTION_MIN_SCALE), renderScale);
+		if (scale == dr.scale)
+			return;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &velocity.pipeline));
+		dr.scale = scale;
+		dr.changes++;
+		dr.averageMs = 0.0f;
+		// Submissions already queued still render at the old size
+		dr.settleFrames = 2 * static_cast<uint32_t>(drawCmdBuffers.size()) + framesInFlight;
+		renderWidth = std::min(std::max(static_cast<uint32_t>(width * scale + 0.5f), 1u), renderTargetWidth);
+		renderHeight = std::min(std::max(static_cast<uint32_t>(height * scale + 0.5f), 1u), renderTargetHeight);
+	}
 
-		pipelineCreateInfo.pVertexInputState = &emptyVertexInputState;
-		pipelineCreateInfo.layout = temproalReproj.pipelineLayout;
-		pipelineCreateInfo.renderPass = temproalReproj.pass.renderPass;
+	void draw()
+	{
+		FrameSync &frame = frameSync[frameIndex];
+		// Only blocks once framesInFlight frames are queued
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
 
-		// Solid rendering pipeline
-		shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/velocity.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/TemprolReprojectionMotion.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// Timings of earlier frames that have finished by now
+		profiler.collect();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &temproalReproj.pipeline));
+#if defined(TAA_HEADLESS)
+		VulkanExampleBase::prepareFrame();
+#else
+		VkResult acquire = swapChain.acquireNextImage(frame.presentComplete, &currentBuffer);
+		if (acquire == VK_ERROR_OUT_OF_DATE_KHR) {
+			// Nothing was acquired, the frame is skipped
+			recreateSwapChain();
+			return;
+		}
+		if (acquire != VK_SUBOPTIMAL_KHR)
+			VK_CHECK_RESULT(acquire);
+#endif
+
+		// The image may still be used by a frame from another fence, its command buffers and
+		// uniform buffer slice can only be touched once that frame is done
+		if (imageFences[currentBuffer] != VK_NULL_HANDLE && imageFences[currentBuffer] != frame.fence)
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFences[currentBuffer], VK_TRUE, UINT64_MAX));
+		imageFences[currentBuffer] = frame.fence;
+		VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+
+		if (dynamicResolution.enabled) {
+			updateDynamicResolution();
+			VkExtent2D &recorded = dynamicResolution.recordedSize[current][currentBuffer];
+			if (recorded.width != renderWidth || recorded.height != renderHeight)
+				recordCommandBuffer(current, currentBuffer);
+		}
 
-		pipelineCreateInfo.renderPass = velocityMax.pass.renderPass;
-		pipelineCreateInfo.layout = velocityMax.pipelineLayout;
-		// Solid rendering pipeline
-	//	shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/velocity.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/velocityMax.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		uniformSlice = currentBuffer;
+		updateTemproalUniformBuffers();
+
+		profiler.submitted(current * static_cast<uint32_t>(drawCmdBuffers.size()) + currentBuffer);
+		if (asyncCompute.enabled) {
+			submitAsyncCompute();
+			frameIndex = (frameIndex + 1) % framesInFlight;
+#if !defined(TAA_HEADLESS)
+			// Reported by the present of the last frame
+			if (swapChainOutOfDate)
+				recreateSwapChain();
+#endif
+			return;
+		}
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &velocityMax.pipeline));
+		// Command buffer to be sumitted to the queue
+		VkSubmitInfo frameSubmitInfo = submitInfo;
+		frameSubmitInfo.commandBufferCount = 1;
+		frameSubmitInfo.pCommandBuffers = &historyCmdBuffers[current][currentBuffer];
+#if !defined(TAA_HEADLESS)
+		frameSubmitInfo.waitSemaphoreCount = 1;
+		frameSubmitInfo.pWaitSemaphores = &frame.presentComplete;
+		frameSubmitInfo.pWaitDstStageMask = &submitPipelineStages;
+		frameSubmitInfo.signalSemaphoreCount = 1;
+		frameSubmitInfo.pSignalSemaphores = &frame.renderComplete;
+#endif
+
+		// Submit to queue, the fence replaces the queue idle of submitFrame
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &frameSubmitInfo, frame.fence));
+
+#if !defined(TAA_HEADLESS)
+		VkResult present = swapChain.queuePresent(queue, currentBuffer, frame.renderComplete);
+		if (present == VK_ERROR_OUT_OF_DATE_KHR || present == VK_SUBOPTIMAL_KHR)
+			swapChainOutOfDate = true;
+		else
+			VK_CHECK_RESULT(present);
+#endif
+
+		if (velocityPrecision.enabled) {
+			// The result buffer is shared by all frames, read it before the next one is queued
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+			uint32_t *result = static_cast<uint32_t*>(velocityPrecision.result.mapped);
+			memcpy(&velocityPrecision.maxError, &result[0], sizeof(float));
+			velocityPrecision.errorPixels = result[1];
+		}
 
-		pipelineCreateInfo.renderPass = renderPass;
-		pipelineCreateInfo.layout = pipelineLayout;
-		// Solid rendering pipeline
-	//	shaderStages[0] = loadShader(getAssetPath() + "shaders/scenerendering/velocity.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getAssetPath() + "shaders/scenerendering/quad.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		if (cpuReference.enabled) {
+			checkCpuReference(frame.fence);
+		}
+
+		frameIndex = (frameIndex + 1) % framesInFlight;
+#if !defined(TAA_HEADLESS)
+		if (swapChainOutOfDate)
+			recreateSwapChain();
+#endif
 	}
 
-	void updateUniformBuffers()
+#if !defined(TAA_HEADLESS)
+	// The steps of VulkanExampleBase::windowResize(), which is private to the base and only
+	// runs on window events. A surface can go out of date without one.
+	void recreateSwapChain()
 	{
+		swapChainOutOfDate = false;
+		prepared = false;
+		vkDeviceWaitIdle(device);
+
+		// The image of the pending post chain goes with the old swapchain, whose handle the new
+		// one may reuse. flushPendingPost() then only submits its barriers.
+		if (asyncCompute.pending)
+			asyncCompute.pendingSwapChain = VK_NULL_HANDLE;
+		swapChain.create(&width, &height, settings.vsync);
+		vkDestroyImageView(device, depthStencil.view, nullptr);
+		vkDestroyImage(device, depthStencil.image, nullptr);
+		vkFreeMemory(device, depthStencil.mem, nullptr);
+		setupDepthStencil();
+		for (VkFramebuffer frameBuffer : frameBuffers)
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		setupFrameBuffer();
+		if (width > 0 && height > 0 && settings.overlay)
+			UIOverlay.resize(width, height);
+
+		// One draw command buffer per swapchain image, the count may change with the swapchain
+		if (drawCmdBuffers.size() != swapChain.imageCount) {
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
+			drawCmdBuffers.resize(swapChain.imageCount);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+				vks::initializers::commandBufferAllocateInfo(
+					cmdPool,
+					VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					static_cast<uint32_t>(drawCmdBuffers.size()));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+		}
+		buildCommandBuffers();
+		vkDeviceWaitIdle(device);
 
+		if (width > 0 && height > 0)
+			camera.updateAspectRatio(static_cast<float>(width) / static_cast<float>(height));
+		windowResized();
+		viewChanged();
+		prepared = true;
+	}
+#endif
 
-		uboSceneMatrices.model = velocity_ubo._CurrM;
-
-		uboSceneMatrices.projection = camera.matrices.perspective;
-		uboSceneMatrices.view = camera.matrices.view;
-		memcpy(building.uniformbuffer.mapped, &uboSceneMatrices, sizeof(uboSceneMatrices));
+	// Geometry of this frame, the post chain of the last frame and the compute work of this
+	// frame, in this order. The compute work waits for both, the last post chain releases the
+	// history it reads. The quad of this frame follows with the next one.
+	void submitAsyncCompute()
+	{
+		VkSemaphore handoff = asyncCompute.graphicsDone[frameIndex];
+
+		VkSubmitInfo geometrySubmitInfo = vks::initializers::submitInfo();
+		geometrySubmitInfo.commandBufferCount = 1;
+		geometrySubmitInfo.pCommandBuffers = &historyCmdBuffers[current][currentBuffer];
+		geometrySubmitInfo.signalSemaphoreCount = asyncCompute.pending ? 0 : 1;
+		geometrySubmitInfo.pSignalSemaphores = &handoff;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &geometrySubmitInfo, VK_NULL_HANDLE));
+
+		if (asyncCompute.pending)
+			submitPendingPost(asyncCompute.postCmdBuffers[asyncCompute.pendingParity][asyncCompute.pendingImage], handoff, true);
+
+		const VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.waitSemaphoreCount = 1;
+		computeSubmitInfo.pWaitSemaphores = &handoff;
+		computeSubmitInfo.pWaitDstStageMask = &computeWaitStage;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &asyncCompute.cmdBuffers[current][currentBuffer];
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &asyncCompute.computeDone[frameIndex];
+		VK_CHECK_RESULT(vkQueueSubmit(asyncCompute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+
+		asyncCompute.pending = true;
+		asyncCompute.pendingParity = current;
+		asyncCompute.pendingImage = currentBuffer;
+		asyncCompute.pendingFrame = frameIndex;
+#if !defined(TAA_HEADLESS)
+		asyncCompute.pendingSwapChain = swapChain.swapChain;
+#endif
+	}
 
+	// Quad of the pending frame behind its compute work, signals the frame's fence. handoff
+	// is signalled for the compute work of the frame submitted next, if there is one.
+	void submitPendingPost(VkCommandBuffer cmdBuffer, VkSemaphore handoff, bool present)
+	{
+		FrameSync &frame = frameSync[asyncCompute.pendingFrame];
+		std::vector<VkSemaphore> waitSemaphores = { asyncCompute.computeDone[asyncCompute.pendingFrame] };
+		std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+		std::vector<VkSemaphore> signalSemaphores;
+		if (handoff != VK_NULL_HANDLE)
+			signalSemaphores.push_back(handoff);
+#if !defined(TAA_HEADLESS)
+		// Acquired with the pending frame, waited for even if the image is not presented
+		waitSemaphores.push_back(frame.presentComplete);
+		waitStages.push_back(submitPipelineStages);
+		if (present)
+			signalSemaphores.push_back(frame.renderComplete);
+#endif
+
+		VkSubmitInfo postSubmitInfo = vks::initializers::submitInfo();
+		postSubmitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		postSubmitInfo.pWaitSemaphores = waitSemaphores.data();
+		postSubmitInfo.pWaitDstStageMask = waitStages.data();
+		postSubmitInfo.commandBufferCount = 1;
+		postSubmitInfo.pCommandBuffers = &cmdBuffer;
+		postSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		postSubmitInfo.pSignalSemaphores = signalSemaphores.data();
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &postSubmitInfo, frame.fence));
+
+#if !defined(TAA_HEADLESS)
+		if (present) {
+			VkResult result = swapChain.queuePresent(queue, asyncCompute.pendingImage, frame.renderComplete);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+				swapChainOutOfDate = true;
+			else
+				VK_CHECK_RESULT(result);
+		}
+#endif
+		asyncCompute.pending = false;
 	}
 
-	void draw()
+	// Falls back to the post chain on the graphics queue without a compute only queue family
+	void prepareAsyncCompute()
 	{
-		VulkanExampleBase::prepareFrame();
+		const uint32_t computeFamily = vulkanDevice->queueFamilyIndices.compute;
+		if (computeFamily == vulkanDevice->queueFamilyIndices.graphics) {
+			std::cout << "No compute only queue family, -asynccompute runs the post chain on the graphics queue" << std::endl;
+			asyncCompute.enabled = false;
+			return;
+		}
+#if !defined(TAA_HEADLESS)
+		// The pending frame holds an image while the next one is acquired
+		if (swapChain.imageCount < 3) {
+			std::cout << "-asynccompute needs three swapchain images, running the post chain on the graphics queue" << std::endl;
+			asyncCompute.enabled = false;
+			return;
+		}
+#endif
+		vkGetDeviceQueue(device, computeFamily, 0, &asyncCompute.queue);
+
+		VkCommandPoolCreateInfo cmdPoolInfo = {};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.queueFamilyIndex = computeFamily;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &asyncCompute.cmdPool));
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		asyncCompute.graphicsDone.resize(framesInFlight);
+		asyncCompute.computeDone.resize(framesInFlight);
+		for (uint32_t f = 0; f < framesInFlight; f++)
+		{
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &asyncCompute.graphicsDone[f]));
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &asyncCompute.computeDone[f]));
+		}
+		renderGraph.setQueueFamilies(vulkanDevice->queueFamilyIndices.graphics, computeFamily);
+	}
 
-		// Command buffer to be sumitted to the queue
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+	// Device local copy of data through a staging buffer
+	void uploadBuffer(VkBufferUsageFlags usage, vks::Buffer &buffer, const void *data, size_t size)
+	{
+		vks::Buffer staging;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&staging,
+			size,
+			const_cast<void*>(data)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&buffer,
+			size));
+		vulkanDevice->copyBuffer(&staging, &buffer, queue);
+		staging.destroy();
+		buffer.setupDescriptor();
+	}
 
-		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	// Binary meshes are copied straight from the file mapping into the staging buffers, other
+	// formats are imported and reordered for the vertex caches first. The position stream can
+	// also be read as storage buffer by the vertex animation pre-pass.
+	void loadModel(const std::string &filename, Mesh &mesh)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const std::vector<MeshFile::Layout> streams = MeshFile::sceneStreams();
+		MeshFile file;
+		MeshFile::Data imported;
+		std::string error;
+		const void *streamData[2] = { nullptr, nullptr };
+		size_t streamBytes[2] = { 0, 0 };
+		const void *indexData = nullptr;
+		size_t indexBytes = 0;
+		const std::string extension = ".taamesh";
+		meshLoad.mapped = filename.size() > extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+		if (meshLoad.mapped) {
+			if (file.map(filename, error) && !file.matches(streams))
+				error = "written for other vertex streams, convert it again with taa_meshconvert";
+			if (error.empty()) {
+				mesh.vertexCount = file.vertexCount();
+				mesh.indexCount = file.indexCount();
+				for (uint32_t s = 0; s < 2; s++)
+				{
+					streamData[s] = file.vertices(s);
+					streamBytes[s] = file.vertexBytes(s);
+				}
+				indexData = file.indices();
+				indexBytes = file.indexBytes();
+			}
+		}
+		else if (MeshFile::import(filename, streams, imported, error)) {
+			MeshFile::optimize(imported);
+			mesh.vertexCount = imported.vertexCount;
+			mesh.indexCount = static_cast<uint32_t>(imported.indices.size());
+			for (uint32_t s = 0; s < 2; s++)
+			{
+				streamData[s] = imported.streams[s].bytes.data();
+				streamBytes[s] = imported.streams[s].bytes.size();
+			}
+			indexData = imported.indices.data();
+			indexBytes = imported.indices.size() * sizeof(uint32_t);
+		}
+		if (!error.empty()) {
+			std::cerr << "Could not load " << filename << ": " << error << std::endl;
+			exit(-1);
+		}
 
-		VulkanExampleBase::submitFrame();
+		uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, mesh.positions, streamData[0], streamBytes[0]);
+		uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mesh.attributes, streamData[1], streamBytes[1]);
+		uploadBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mesh.indices, indexData, indexBytes);
+		meshLoad.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 	}
 
 	void loadAssets()
 	{
-		models.scene.loadFromFile(getAssetPath() + "models/cube.obj", vertexLayout, 1.0f, vulkanDevice, queue);
+		// The build converts the model with taa_meshconvert, the OBJ is the fallback
+		if (meshLoad.path.empty()) {
+			meshLoad.path = getAssetPath() + "models/cube.taamesh";
+			if (!std::ifstream(meshLoad.path).good())
+				meshLoad.path = getAssetPath() + "models/cube.obj";
+		}
+		loadModel(meshLoad.path, models.scene);
+	}
+
+	// Two position streams of the scene model, written by the pre-pass in turns
+	void prepareVertexAnimation()
+	{
+		for (auto &positions : vertexAnimation.positions)
+		{
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&positions,
+				models.scene.positions.size));
+			positions.setupDescriptor();
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
-	void prepareUniformBuffers()
+	// Ring of uniformSliceCount aligned slices, one per swapchain image
+	void prepareUniformRing(Graphics &graphics, VkDeviceSize size)
 	{
+		VkDeviceSize alignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
+		graphics.uniformStride = (size + alignment - 1) & ~(alignment - 1);
+		graphics.uniformbuffer.destroy();
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&building.uniformbuffer,
-			sizeof(uboSceneMatrices)));
+			&graphics.uniformbuffer,
+			graphics.uniformStride * uniformSliceCount));
+		// Map persistent
+		VK_CHECK_RESULT(graphics.uniformbuffer.map());
+		// Descriptors cover one slice, the dynamic offset selects it
+		graphics.uniformbuffer.setupDescriptor(size);
+	}
 
+	// Same ring layout for the instance transforms, bound as a dynamic storage buffer
+	void prepareInstanceRing()
+	{
+		VkDeviceSize size = instances.count * sizeof(InstanceTransform);
+		VkDeviceSize alignment = vulkanDevice->properties.limits.minStorageBufferOffsetAlignment;
+		instances.stride = (size + alignment - 1) & ~(alignment - 1);
+		instances.buffer.destroy();
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&velocity.uniformbuffer,
-			sizeof(velocity_ubo)));
-
+			&instances.buffer,
+			instances.stride * uniformSliceCount));
+		VK_CHECK_RESULT(instances.buffer.map());
+		instances.buffer.setupDescriptor(size);
+	}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&temproalReproj.uniformbuffer,
-			sizeof(temprolReproj_ubo)));
-		;
-		VK_CHECK_RESULT(building.uniformbuffer.map());
+	void prepareUniformRings()
+	{
+		uniformSliceCount = static_cast<uint32_t>(drawCmdBuffers.size());
+		prepareUniformRing(building, sizeof(uboSceneMatrices));
+		prepareUniformRing(velocity, sizeof(velocity_ubo));
+		prepareUniformRing(temproalReproj, sizeof(temprolReproj_ubo));
+		prepareInstanceRing();
+	}
 
-		// Map persistent
-		VK_CHECK_RESULT(velocity.uniformbuffer.map());
-		VK_CHECK_RESULT(temproalReproj.uniformbuffer.map());
-		velocity_ubo._CurrM = glm::mat4(1.0);
+	void prepareUniformBuffers()
+	{
+		prepareUniformRings();
+		instances.transforms.resize(instances.count);
+		for (uint32_t index = 0; index < instances.count; index++)
+		{
+			instances.transforms[index].curr = instanceTransform(index, 0.0f);
+		}
 
 		velocity_ubo._CurrVP = camera.matrices.perspective*camera.matrices.view;
-		updateTemproalUniformBuffers();
+	}
 
+	void prepareFrameSync()
+	{
+		frameSync.resize(framesInFlight);
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		for (auto &frame : frameSync)
+		{
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		}
 	}
+
 	glm::vec4 GetProjectionExtents(float texelOffsetX, float texelOffsetY)
 	{
 
 
 		float oneExtentY = tan(0.5f * 0.0174532924F * camera.fov);
 		float oneExtentX = oneExtentY * camera.aspect;
-		float texelSizeX = oneExtentX / (0.5f * width);
-		float texelSizeY = oneExtentY / (0.5f * height);
+		// Jitter by texels of the render target, smaller than window pixels with -renderscale
+		float texelSizeX = oneExtentX / (0.5f * renderWidth);
+		float texelSizeY = oneExtentY / (0.5f * renderHeight);
 		float oneJitterX = texelSizeX * texelOffsetX;
 		float oneJitterY = texelSizeY * texelOffsetY;
 
@@ -782,32 +2544,72 @@ public:
 
 		return GetPerspectiveProjection(xm * cn, xp * cn, ym * cn, yp * cn, cn, cf);
 	}
+	// A single instance moves along x like the original scene, more instances are laid out on
+	// a grid in the xz plane, move out of phase and most of them also spin
+	glm::mat4 instanceTransform(uint32_t index, float time) const
+	{
+		const uint32_t side = static_cast<uint32_t>(ceil(sqrt(static_cast<float>(instances.count))));
+		const float spacing = 4.0f;
+		glm::vec3 position(
+			(static_cast<float>(index % side) - (side - 1) * 0.5f) * spacing,
+			0.0f,
+			(static_cast<float>(index / side) - (side - 1) * 0.5f) * spacing);
+		position.x += sin(time + index * 0.7f) * 10.0f / side;
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+		return glm::rotate(transform, time * (index % 7) * 0.25f, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	// Written once per frame into the slice of this swapchain image
+	void updateInstanceBuffer()
+	{
+		for (uint32_t index = 0; index < instances.count; index++)
+		{
+			InstanceTransform &instance = instances.transforms[index];
+			instance.prev = instance.curr;
+			instance.curr = instanceTransform(index, timer);
+		}
+		memcpy(static_cast<char*>(instances.buffer.mapped) + uniformSlice * instances.stride, instances.transforms.data(), instances.count * sizeof(InstanceTransform));
+	}
+
 	// Update uniform buffers for rendering the 3D scene
 	void updateTemproalUniformBuffers()
 	{
 		first++;
-		velocity_ubo._PrevM = velocity_ubo._CurrM;
 		velocity_ubo._PrevVP = velocity_ubo._CurrVP;
-		velocity_ubo._CurrM[3][0] = sin(timer) * 10;
+		// No positions of the last frame exist for the very first frame
+		velocity_ubo._AnimationTime = glm::vec4(timer, first == 1 ? 1.0f : 0.0f, 0.0f, 0.0f);
+		updateInstanceBuffer();
 		camera.matrices.perspective = glm::transpose(GetProjectionMatrix(frustumJitter.activeSample.z, frustumJitter.activeSample.w));
 		velocity_ubo._CurrVP = camera.matrices.perspective*camera.matrices.view;
 		
 		updateUniformBuffers();
-		memcpy(velocity.uniformbuffer.mapped, &velocity_ubo, sizeof(velocity_ubo));
+		memcpy(static_cast<char*>(velocity.uniformbuffer.mapped) + uniformSlice * velocity.uniformStride, &velocity_ubo, sizeof(velocity_ubo));
 
-		glm::vec2 texelOffset = frustumJitter.GetHaltonJitter(frustumJitter.m_currentIndex);
+		frustumJitter.Advance();
 		temprolReproj_ubo.JitterUV = frustumJitter.activeSample;
-		temprolReproj_ubo.JitterUV.x /= width;
-		temprolReproj_ubo.JitterUV.y /= height;
-		temprolReproj_ubo.JitterUV.z /= width;
-		temprolReproj_ubo.JitterUV.w /= height;
+		temprolReproj_ubo.JitterUV.x /= renderWidth;
+		temprolReproj_ubo.JitterUV.y /= renderHeight;
+		temprolReproj_ubo.JitterUV.z /= renderWidth;
+		temprolReproj_ubo.JitterUV.w /= renderHeight;
+		temprolReproj_ubo._RenderScale = glm::vec4(
+			(float)renderWidth / width, (float)renderHeight / height,
+			(float)renderWidth / renderTargetWidth, (float)renderHeight / renderTargetHeight);
 
 
-		temprolReproj_ubo._FeedbackMin_Max_Mscale = glm::vec4(0.88f, 0.97f, 0.0f, 0.0f);
+		// No valid history exists for the very first frame
+		if (first == 1)
+			temprolReproj_ubo._FeedbackMin_Max_Mscale = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+		else
+			temprolReproj_ubo._FeedbackMin_Max_Mscale = glm::vec4(0.88f, 0.97f, 0.0f, 0.0f);
 		temprolReproj_ubo._SinTime = glm::vec4(timer / 8.0, timer / 4.0, timer / 2.0, timer);
-		memcpy(temproalReproj.uniformbuffer.mapped, &temprolReproj_ubo, sizeof(temprolReproj_ubo));
+		memcpy(static_cast<char*>(temproalReproj.uniformbuffer.mapped) + uniformSlice * temproalReproj.uniformStride, &temprolReproj_ubo, sizeof(temprolReproj_ubo));
 
 	}
+	VkDescriptorType quadDescriptorType()
+	{
+		return useSubpasses ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	}
+
 	void setupDescriptorSetLayout()
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
@@ -815,8 +2617,9 @@ public:
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
 
 		setLayoutBindings = {
-		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),			// Binding 0: Fragment shader uniform buffer
-	//	vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Binding 1: Fragment shader image sampler
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),			// Binding 0: Fragment shader uniform buffer
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 1),			// Binding 1: Velocity matrices, read by sceneVelocity.vert
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 2),			// Binding 2: Instance transforms
 		};
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &building.descriptorSetLayout));
@@ -824,27 +2627,78 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &building.pipelineLayout));
 
 		setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),			// Binding 0: Fragment shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Binding 1: Fragment shader image sampler
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),			// Binding 0: Fragment shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),	// Binding 1: Fragment shader image sampler
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 2)		// Binding 2: Instance transforms
 		};
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &velocity.descriptorSetLayout));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&velocity.descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &velocity.pipelineLayout));
 
+		// Both velocity reduction stages: read the previous level, write the tile target
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Input
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)			// Binding 1: Output
+		};
+		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &velocityTiles.descriptorSetLayout));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&velocityTiles.descriptorSetLayout, 1);
+		// Rendered pixels and tiles, see recordCommandBuffer
+		VkPushConstantRange renderTilesRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 4 * sizeof(int32_t), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &renderTilesRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &velocityTiles.pipelineLayout));
+
+		// Closest depth dilation
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),	// Binding 1: Velocity
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2)			// Binding 2: Dilated velocity
+		};
+		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &velocityDilate.descriptorSetLayout));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&velocityDilate.descriptorSetLayout, 1);
+		// Rendered pixels, see recordVelocityDilatePass
+		VkPushConstantRange renderSizeRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 2 * sizeof(int32_t), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &renderSizeRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &velocityDilate.pipelineLayout));
+
+		// Vertex animation pre-pass
+		if (vertexAnimation.enabled) {
+			setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Velocity uniform buffer, animation time
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),			// Binding 1: Model positions
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),			// Binding 2: Positions of this frame
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3)			// Binding 3: Positions of the last frame
+			};
+			descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &vertexAnimation.descriptorSetLayout));
+			pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&vertexAnimation.descriptorSetLayout, 1);
+			// Vertex count and vertex stride in floats
+			VkPushConstantRange vertexFormatRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 2 * sizeof(uint32_t), 0);
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &vertexFormatRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &vertexAnimation.pipelineLayout));
+		}
+
+		// Velocity precision check
 		setLayoutBindings = {
-		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)	// Binding 1: Fragment shader image sampler
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Compact velocity
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),	// Binding 1: fp32 reference
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)			// Binding 2: Result
 		};
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &velocityMax.descriptorSetLayout));
-		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&velocityMax.descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &velocityMax.pipelineLayout));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &velocityPrecision.descriptorSetLayout));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&velocityPrecision.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &velocityPrecision.pipelineLayout));
 
 		// Scene rendering
 		setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),			// Binding 0: Fragment shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 0),			// Binding 0: Fragment shader uniform buffer
 
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),	// Binding 1 : Fragment shader image sampler			
+			// Binding 1, the depth target, is only read by the velocity dilation
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),	// Binding 1 : Fragment shader image sampler			
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),	// Binding 1 : Fragment shader image sampler			
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),	// Binding 1 : Fragment shader image sampler			
@@ -857,9 +2711,24 @@ public:
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&temproalReproj.descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &temproalReproj.pipelineLayout));
 
-		// Scene rendering
+		// Compute resolve, same inputs as the fragment path plus the history target as storage image
 		setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)	// Binding 1 : Fragment shader image sampler			
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 0),			// Binding 0: Compute shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),	// Binding 2: Color
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 3),	// Binding 3: Previous history
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4),	// Binding 4: Velocity max
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5),	// Binding 5: Dilated velocity
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 6),			// Binding 6: Resolve target
+		};
+
+		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), setLayoutBindings.size());
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &temproalReprojCompute.descriptorSetLayout));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&temproalReprojCompute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &temproalReprojCompute.pipelineLayout));
+
+		// Scene rendering, the history target is an input attachment with -subpasses
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(quadDescriptorType(), VK_SHADER_STAGE_FRAGMENT_BIT, 0)	// Binding 1 : Fragment shader image sampler			
 
 
 		};
@@ -873,15 +2742,19 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 11),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 31),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 7),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				10);
+				20);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -893,138 +2766,377 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &building.descriptorSet));
 
 
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+		std::array<VkDescriptorSetLayout, 2> quadSetLayouts = { descriptorSetLayout, descriptorSetLayout };
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, quadSetLayouts.data(), static_cast<uint32_t>(quadSetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, quadDescriptorSets.data()));
+
+
+		std::array<VkDescriptorSetLayout, 2> velocitySetLayouts = { velocity.descriptorSetLayout, velocity.descriptorSetLayout };
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, velocitySetLayouts.data(), static_cast<uint32_t>(velocitySetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, velocityDescriptorSets.data()));
+
 
 
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &velocity.descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &velocity.descriptorSet));
+		std::array<VkDescriptorSetLayout, 2> tileMaxSetLayouts = { velocityTiles.descriptorSetLayout, velocityTiles.descriptorSetLayout };
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, tileMaxSetLayouts.data(), static_cast<uint32_t>(tileMaxSetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, velocityTiles.tileMaxDescriptorSets.data()));
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &velocityTiles.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &velocityTiles.neighborMaxDescriptorSet));
 
+		std::array<VkDescriptorSetLayout, 2> dilateSetLayouts = { velocityDilate.descriptorSetLayout, velocityDilate.descriptorSetLayout };
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, dilateSetLayouts.data(), static_cast<uint32_t>(dilateSetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, velocityDilate.descriptorSets.data()));
 
+		if (velocityPrecision.enabled) {
+			descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &velocityPrecision.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &velocityPrecision.descriptorSet));
+		}
+
+		if (vertexAnimation.enabled) {
+			std::array<VkDescriptorSetLayout, 2> animationSetLayouts = { vertexAnimation.descriptorSetLayout, vertexAnimation.descriptorSetLayout };
+			descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, animationSetLayouts.data(), static_cast<uint32_t>(animationSetLayouts.size()));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, vertexAnimation.descriptorSets.data()));
+		}
 
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &velocityMax.descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &velocityMax.descriptorSet));
 
 
+		std::array<VkDescriptorSetLayout, 2> historySetLayouts = { temproalReproj.descriptorSetLayout, temproalReproj.descriptorSetLayout };
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, historySetLayouts.data(), static_cast<uint32_t>(historySetLayouts.size()));
 
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &temproalReproj.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, historyDescriptorSets.data()));
 
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &temproalReproj.descriptorSet));
+		std::array<VkDescriptorSetLayout, 2> computeSetLayouts = { temproalReprojCompute.descriptorSetLayout, temproalReprojCompute.descriptorSetLayout };
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, computeSetLayouts.data(), static_cast<uint32_t>(computeSetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, temproalReprojCompute.descriptorSets.data()));
 
 		updateDescriptorSet();
 
 
 	}
+	// Written once after the targets are created, both history parities are wired up front
 	void updateDescriptorSet() {
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
-		VkDescriptorImageInfo depthMapDescriptor =
+		VkDescriptorImageInfo velocityMaxDescriptor =
 			vks::initializers::descriptorImageInfo(
 				colorsampler,
-				building.pass.framebuffers[0].depth.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				velocityTiles.neighborMax.view,
+				VK_IMAGE_LAYOUT_GENERAL);
 
-		VkDescriptorImageInfo colorMapDescriptor =
+		VkDescriptorImageInfo tileMaxDescriptor =
 			vks::initializers::descriptorImageInfo(
 				colorsampler,
-				building.pass.framebuffers[0].color.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				velocityTiles.tileMax.view,
+				VK_IMAGE_LAYOUT_GENERAL);
 
-		VkDescriptorImageInfo velocityDescriptor =
-			vks::initializers::descriptorImageInfo(
-				colorsampler,
-				velocity.pass.framebuffers[0].color.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo tileMaxStorageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, velocityTiles.tileMax.view, VK_IMAGE_LAYOUT_GENERAL);
+		VkDescriptorImageInfo neighborMaxStorageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, velocityTiles.neighborMax.view, VK_IMAGE_LAYOUT_GENERAL);
 
-		VkDescriptorImageInfo currDescriptor =
+		VkDescriptorImageInfo dilatedVelocityDescriptor =
 			vks::initializers::descriptorImageInfo(
 				colorsampler,
-				temproalReproj.pass.framebuffers[current].color.view,
+				velocityDilate.target.view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo dilatedVelocityStorageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, velocityDilate.target.view, VK_IMAGE_LAYOUT_GENERAL);
 
-		VkDescriptorImageInfo preDescriptor;
-		if (first == 1)
-			preDescriptor =
-			vks::initializers::descriptorImageInfo(
-				colorsampler,
-				building.pass.framebuffers[0].color.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		else
+		for (int parity = 0; parity < 2; parity++)
 		{
-			preDescriptor =
+			// Building and velocity targets of the frame of this parity
+			VkDescriptorImageInfo depthMapDescriptor =
 				vks::initializers::descriptorImageInfo(
 					colorsampler,
-					temproalReproj.pass.framebuffers[1 - current].color.view,
-					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		}
-
+					building.pass.framebuffers[inputTarget(parity)].depth.view,
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
+			VkDescriptorImageInfo colorMapDescriptor =
+				vks::initializers::descriptorImageInfo(
+					colorsampler,
+					building.pass.framebuffers[inputTarget(parity)].color.view,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+			VkDescriptorImageInfo velocityDescriptor =
+				vks::initializers::descriptorImageInfo(
+					colorsampler,
+					velocity.pass.framebuffers[inputTarget(parity)].color.view,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+			VkDescriptorImageInfo currDescriptor =
+				vks::initializers::descriptorImageInfo(
+					colorsampler,
+					temproalReproj.pass.framebuffers[parity].color.view,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-		VkDescriptorImageInfo velocityMaxDescriptor =
-			vks::initializers::descriptorImageInfo(
-				colorsampler,
-				velocityMax.pass.framebuffers[0].color.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo preDescriptor =
+				vks::initializers::descriptorImageInfo(
+					colorsampler,
+					temproalReproj.pass.framebuffers[1 - parity].color.view,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+			writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(historyDescriptorSets[parity], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &temproalReproj.uniformbuffer.descriptor),
 
-		writeDescriptorSets = {
-		vks::initializers::writeDescriptorSet(temproalReproj.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &temproalReproj.uniformbuffer.descriptor),
-		vks::initializers::writeDescriptorSet(temproalReproj.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthMapDescriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(historyDescriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &colorMapDescriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(historyDescriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &preDescriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(historyDescriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &velocityMaxDescriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(historyDescriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &dilatedVelocityDescriptor),	// Binding 1: Fragment shader texture sampler
 
-		vks::initializers::writeDescriptorSet(temproalReproj.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &colorMapDescriptor),	// Binding 1: Fragment shader texture sampler
-		vks::initializers::writeDescriptorSet(temproalReproj.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &preDescriptor),	// Binding 1: Fragment shader texture sampler
-		vks::initializers::writeDescriptorSet(temproalReproj.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &velocityMaxDescriptor),	// Binding 1: Fragment shader texture sampler
-		vks::initializers::writeDescriptorSet(temproalReproj.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &velocityDescriptor)	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(quadDescriptorSets[parity], quadDescriptorType(), 0, &currDescriptor),	// Binding 1: Fragment shader texture sampler
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+			// The compute resolve writes the current history target in GENERAL layout
+			VkDescriptorImageInfo resolveTargetDescriptor =
+				vks::initializers::descriptorImageInfo(
+					VK_NULL_HANDLE,
+					temproalReproj.pass.framebuffers[parity].color.view,
+					VK_IMAGE_LAYOUT_GENERAL);
+
+			VkDescriptorSet computeSet = temproalReprojCompute.descriptorSets[parity];
+			writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(computeSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &temproalReproj.uniformbuffer.descriptor),
+			vks::initializers::writeDescriptorSet(computeSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &colorMapDescriptor),
+			vks::initializers::writeDescriptorSet(computeSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &preDescriptor),
+			vks::initializers::writeDescriptorSet(computeSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &velocityMaxDescriptor),
+			vks::initializers::writeDescriptorSet(computeSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &dilatedVelocityDescriptor),
+			vks::initializers::writeDescriptorSet(computeSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, &resolveTargetDescriptor),
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(velocityTiles.tileMaxDescriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &velocityDescriptor),
+				vks::initializers::writeDescriptorSet(velocityTiles.tileMaxDescriptorSets[parity], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &tileMaxStorageDescriptor),
+				vks::initializers::writeDescriptorSet(velocityDilate.descriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &depthMapDescriptor),
+				vks::initializers::writeDescriptorSet(velocityDilate.descriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &velocityDescriptor),
+				vks::initializers::writeDescriptorSet(velocityDilate.descriptorSets[parity], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &dilatedVelocityStorageDescriptor),
+				vks::initializers::writeDescriptorSet(velocityDescriptorSets[parity], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &velocity.uniformbuffer.descriptor),				// Binding 0: Fragment shader uniform buffer
+				vks::initializers::writeDescriptorSet(velocityDescriptorSets[parity], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthMapDescriptor),	// Binding 1: Fragment shader texture sampler
+				vks::initializers::writeDescriptorSet(velocityDescriptorSets[parity], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2, &instances.buffer.descriptor),	// Binding 2: Instance transforms
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		}
 
 		writeDescriptorSets = {
-		vks::initializers::writeDescriptorSet(building.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &building.uniformbuffer.descriptor),	// Binding 1: Fragment shader texture sampler
+		vks::initializers::writeDescriptorSet(building.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &building.uniformbuffer.descriptor),	// Binding 1: Fragment shader texture sampler
+		vks::initializers::writeDescriptorSet(building.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &velocity.uniformbuffer.descriptor),
+		vks::initializers::writeDescriptorSet(building.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2, &instances.buffer.descriptor),
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
 
 
 		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(velocityMax.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &velocityDescriptor)			// Binding 0: Fragment shader uniform buffer			
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(velocity.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &velocity.uniformbuffer.descriptor),				// Binding 0: Fragment shader uniform buffer			
-			vks::initializers::writeDescriptorSet(velocity.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthMapDescriptor),	// Binding 1: Fragment shader texture sampler
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-
-		writeDescriptorSets = {
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &currDescriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(velocityTiles.neighborMaxDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &tileMaxDescriptor),
+			vks::initializers::writeDescriptorSet(velocityTiles.neighborMaxDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &neighborMaxStorageDescriptor),
 		};
-
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
+		// Off with -asynccompute, there is a single velocity target then
+		if (velocityPrecision.enabled) {
+			VkDescriptorImageInfo velocityDescriptor =
+				vks::initializers::descriptorImageInfo(
+					colorsampler,
+					velocity.pass.framebuffers[0].color.view,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo referenceDescriptor =
+				vks::initializers::descriptorImageInfo(
+					colorsampler,
+					velocityPrecision.pass.framebuffers[0].color.view,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(velocityPrecision.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &velocityDescriptor),
+				vks::initializers::writeDescriptorSet(velocityPrecision.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &referenceDescriptor),
+				vks::initializers::writeDescriptorSet(velocityPrecision.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &velocityPrecision.result.descriptor),
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		}
 
+		if (vertexAnimation.enabled) {
+			for (int parity = 0; parity < 2; parity++)
+			{
+				VkDescriptorSet animationSet = vertexAnimation.descriptorSets[parity];
+				writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(animationSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &velocity.uniformbuffer.descriptor),
+					vks::initializers::writeDescriptorSet(animationSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &models.scene.positions.descriptor),
+					vks::initializers::writeDescriptorSet(animationSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &vertexAnimation.positions[parity].descriptor),
+					vks::initializers::writeDescriptorSet(animationSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &vertexAnimation.positions[1 - parity].descriptor),
+				};
+				vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+			}
+		}
+	}
+	VkImageUsageFlags cpuReferenceUsage() const
+	{
+		return cpuReference.enabled ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0;
+	}
 
+	// Host visible copy of everything the resolve reads and writes, recorded once per parity
+	void prepareCpuReference()
+	{
+		cpuReference.reference.reset(new TaaReference());
+		cpuReference.reference->setIsa(TaaReference::bestIsa());
+
+		const VkDeviceSize pixels = static_cast<VkDeviceSize>(width) * height;
+		cpuReference.velocityOffset = pixels * 4;
+		// DILATED_VELOCITY_FORMAT, four half floats
+		cpuReference.previousOffset = cpuReference.velocityOffset + pixels * 4 * sizeof(uint16_t);
+		cpuReference.currentOffset = cpuReference.previousOffset + pixels * 4;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&cpuReference.readback,
+			cpuReference.currentOffset + pixels * 4));
+		VK_CHECK_RESULT(cpuReference.readback.map());
+		cpuReference.velocity.resize(pixels * 2);
+		cpuReference.output.resize(pixels * 4);
+
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+			vks::initializers::commandBufferAllocateInfo(
+				cmdPool,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				static_cast<uint32_t>(cpuReference.cmdBuffers.size()));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cpuReference.cmdBuffers.data()));
 
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		for (uint32_t parity = 0; parity < 2; parity++)
+		{
+			// Every source is in SHADER_READ_ONLY_OPTIMAL once the frame is done
+			const VkImage images[4] = {
+				building.pass.framebuffers[0].color.image,
+				velocityDilate.target.image,
+				temproalReproj.pass.framebuffers[1 - parity].color.image,
+				temproalReproj.pass.framebuffers[parity].color.image
+			};
+			const VkDeviceSize offsets[4] = { 0, cpuReference.velocityOffset, cpuReference.previousOffset, cpuReference.currentOffset };
+
+			VkCommandBuffer cmdBuffer = cpuReference.cmdBuffers[parity];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+			std::array<VkImageMemoryBarrier, 4> imageBarriers;
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				imageBarriers[i] = vks::initializers::imageMemoryBarrier();
+				imageBarriers[i].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				imageBarriers[i].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageBarriers[i].image = images[i];
+				imageBarriers[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			}
+			vkCmdPipelineBarrier(
+				cmdBuffer,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				VkBufferImageCopy region = {};
+				region.bufferOffset = offsets[i];
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.imageExtent = { width, height, 1 };
+				vkCmdCopyImageToBuffer(cmdBuffer, images[i], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cpuReference.readback.buffer, 1, &region);
+			}
 
+			for (auto &imageBarrier : imageBarriers)
+			{
+				imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(
+				cmdBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+				0,
+				1, &memoryBarrier,
+				0, nullptr,
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		}
+	}
 
+	// Reads back the frame guarded by fence and resolves it again on the CPU
+	void checkCpuReference(VkFence fence)
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+		VkSubmitInfo readbackSubmitInfo = vks::initializers::submitInfo();
+		readbackSubmitInfo.commandBufferCount = 1;
+		readbackSubmitInfo.pCommandBuffers = &cpuReference.cmdBuffers[current];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &readbackSubmitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+
+		const uint8_t *readback = static_cast<const uint8_t*>(cpuReference.readback.mapped);
+		const size_t pixels = static_cast<size_t>(width) * height;
+		TaaReference::Frame frame;
+		frame.width = width;
+		frame.height = height;
+		frame.color = readback;
+		frame.history = readback + cpuReference.previousOffset;
+		// The resolve reads the dilated velocity, the xy half floats of every texel are its uv velocity
+		const uint32_t *packed = reinterpret_cast<const uint32_t*>(readback + cpuReference.velocityOffset);
+		for (size_t i = 0; i < pixels; i++) {
+			glm::vec2 v = glm::unpackHalf2x16(packed[i * 2]);
+			cpuReference.velocity[i * 2 + 0] = v.x;
+			cpuReference.velocity[i * 2 + 1] = v.y;
+		}
+		frame.velocity = cpuReference.velocity.data();
+		frame.velocityStride = 2;
+
+		// Uniforms of the frame just resolved
+		TaaReference::Params params;
+		params.jitterUV[0] = temprolReproj_ubo.JitterUV.x;
+		params.jitterUV[1] = temprolReproj_ubo.JitterUV.y;
+		params.feedbackMin = temprolReproj_ubo._FeedbackMin_Max_Mscale.x;
+		params.feedbackMax = temprolReproj_ubo._FeedbackMin_Max_Mscale.y;
+		params.sinTime = temprolReproj_ubo._SinTime.x;
+		// Decoded by velocityDilate.comp already
+		params.velocityScale = 1.0f;
+		// Rounds like the float16_t build so the tolerance holds for both
+		params.halfPrecision = resolveFp16;
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+		cpuReference.reference->resolve(frame, params, cpuReference.output.data());
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+		cpuReference.maxDifference = TaaReference::compare(cpuReference.output.data(), readback + cpuReference.currentOffset, width, height, CPU_REFERENCE_TOLERANCE, &cpuReference.pixelsAboveTolerance);
+		cpuReference.worstDifference = std::max(cpuReference.worstDifference, cpuReference.maxDifference);
+		if (cpuReference.pixelsAboveTolerance > 0)
+			cpuReference.framesAboveTolerance++;
+		cpuReference.frames++;
+		cpuReference.resolveMs += (ms - cpuReference.resolveMs) / cpuReference.frames;
+
+		if (resolveFp16) {
+			params.halfPrecision = false;
+			cpuReference.outputFp32.resize(cpuReference.output.size());
+			cpuReference.reference->resolve(frame, params, cpuReference.outputFp32.data());
+			cpuReference.fp32MaxDifference = TaaReference::compare(cpuReference.outputFp32.data(), readback + cpuReference.currentOffset, width, height, 1, &cpuReference.fp32PixelsAboveOne);
+			cpuReference.fp32WorstDifference = std::max(cpuReference.fp32WorstDifference, cpuReference.fp32MaxDifference);
+		}
 	}
+
 	// Prepare the offscreen framebuffers used for the vertical- and horizontal blur 
-	void prepareBuilding(int width, int height, VkFormat FB_COLOR_FORMAT)
+	// VELOCITY_FORMAT: adds the velocity target as second color attachment when not VK_FORMAT_UNDEFINED
+	void prepareBuilding(int width, int height, VkFormat FB_COLOR_FORMAT, VkFormat VELOCITY_FORMAT = VK_FORMAT_UNDEFINED)
 	{
+		const bool writeVelocity = (VELOCITY_FORMAT != VK_FORMAT_UNDEFINED);
 		building.pass.width = width;
 		building.pass.height = height;
 
 		// Find a suitable depth format
-		VkFormat fbDepthFormat = VK_FORMAT_D16_UNORM;
+		VkFormat fbDepthFormat = BUILDING_DEPTH_FORMAT;
 		//VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
 		//assert(validDepthFormat);
 
 		// Create a separate render pass for the offscreen rendering as it may differ from the one used for scene rendering
 
-		std::array<VkAttachmentDescription, 2> attchmentDescriptions = {};
+		std::array<VkAttachmentDescription, 3> attchmentDescriptions = {};
 		// Color attachment
 		attchmentDescriptions[0].format = FB_COLOR_FORMAT;
 		attchmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1032,8 +3144,9 @@ public:
 		attchmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attchmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attchmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// Layout transitions and barriers come from the render graph
+		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 		// Depth attachment
 		attchmentDescriptions[1].format = fbDepthFormat;
 		attchmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1041,126 +3154,46 @@ public:
 		attchmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attchmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attchmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attchmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		attchmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		// Velocity attachment, same image as velocity.pass.framebuffers[t].color
+		attchmentDescriptions[2] = attchmentDescriptions[0];
+		attchmentDescriptions[2].format = VELOCITY_FORMAT;
 
-		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		std::array<VkAttachmentReference, 2> colorReferences = { { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } } };
 		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
 		VkSubpassDescription subpassDescription = {};
 		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpassDescription.colorAttachmentCount = 1;
-		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.colorAttachmentCount = writeVelocity ? 2 : 1;
+		subpassDescription.pColorAttachments = colorReferences.data();
 		subpassDescription.pDepthStencilAttachment = &depthReference;
 
-		// Use subpass dependencies for layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
-
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
 		// Create the actual renderpass
 		VkRenderPassCreateInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attchmentDescriptions.size());
+		renderPassInfo.attachmentCount = writeVelocity ? 3 : 2;
 		renderPassInfo.pAttachments = attchmentDescriptions.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpassDescription;
-		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
-		renderPassInfo.pDependencies = dependencies.data();
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &building.pass.renderPass));
 
-		building.pass.framebuffers.resize(1);
-		// Create two frame buffers
-		prepareBuildingFramebuffer(&building.pass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat, width, height);
+		for (uint32_t t = 0; t < building.pass.framebuffers.size(); t++)
+			prepareBuildingFramebuffer(&building.pass.framebuffers[t], width, height, writeVelocity ? velocity.pass.framebuffers[t].color.view : VK_NULL_HANDLE);
 
 	}
-	void prepareBuildingFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat, int width, int height)
+	// Color and depth targets are created by prepareRenderTargets()
+	void prepareBuildingFramebuffer(FrameBuffer *frameBuf, int width, int height, VkImageView velocityView)
 	{
-		// Color attachment
-		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = colorFormat;
-		image.extent.width = width;
-		image.extent.height = height;
-		image.extent.depth = 1;
-		image.mipLevels = 1;
-		image.arrayLayers = 1;
-		image.samples = VK_SAMPLE_COUNT_1_BIT;
-		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		// We will sample directly from the color attachment
-		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = colorFormat;
-		colorImageView.flags = 0;
-		colorImageView.subresourceRange = {};
-		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		colorImageView.subresourceRange.baseMipLevel = 0;
-		colorImageView.subresourceRange.levelCount = 1;
-		colorImageView.subresourceRange.baseArrayLayer = 0;
-		colorImageView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->color.image));
-		vkGetImageMemoryRequirements(device, frameBuf->color.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->color.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->color.image, frameBuf->color.mem, 0));
-
-		colorImageView.image = frameBuf->color.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &frameBuf->color.view));
-
-		// Depth stencil attachment
-		image.format = depthFormat;
-		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		depthStencilView.format = depthFormat;
-		depthStencilView.flags = 0;
-		depthStencilView.subresourceRange = {};
-		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		depthStencilView.subresourceRange.baseMipLevel = 0;
-		depthStencilView.subresourceRange.levelCount = 1;
-		depthStencilView.subresourceRange.baseArrayLayer = 0;
-		depthStencilView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->depth.image));
-		vkGetImageMemoryRequirements(device, frameBuf->depth.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->depth.image, frameBuf->depth.mem, 0));
-
-		depthStencilView.image = frameBuf->depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &frameBuf->depth.view));
-
-		VkImageView attachments[2];
+		VkImageView attachments[3];
 		attachments[0] = frameBuf->color.view;
 		attachments[1] = frameBuf->depth.view;
+		attachments[2] = velocityView;
 
 		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
 		fbufCreateInfo.renderPass = building.pass.renderPass;
-		fbufCreateInfo.attachmentCount = 2;
+		fbufCreateInfo.attachmentCount = (velocityView != VK_NULL_HANDLE) ? 3 : 2;
 		fbufCreateInfo.pAttachments = attachments;
 		fbufCreateInfo.width = width;
 		fbufCreateInfo.height = height;
@@ -1188,22 +3221,67 @@ public:
 	}
 	void prepare()
 	{
+		auto tStart = std::chrono::high_resolution_clock::now();
 		VulkanExampleBase::prepare();
+		if (pipelineStartup.persistent) {
+			// Replaces the empty cache created by the base class
+			vkDestroyPipelineCache(device, pipelineCache, nullptr);
+			if (pipelineStartup.path.empty())
+				pipelineStartup.path = PipelineCacheFile::defaultPath(deviceProperties);
+			pipelineCache = pipelineStartup.file.load(device, deviceProperties, pipelineStartup.path);
+			if (pipelineStartup.file.status() == PipelineCacheFile::STATUS_INVALID)
+				std::cout << "Pipeline cache " << pipelineStartup.path << " does not match the device or driver, starting empty" << std::endl;
+		}
+		if (asyncCompute.enabled)
+			prepareAsyncCompute();
 		loadAssets();
+		if (vertexAnimation.enabled)
+			prepareVertexAnimation();
 		createSampler();
 		prepareUniformBuffers();
-
-		prepareBuilding(width, height, VK_FORMAT_R8G8B8A8_UNORM);
-		prepareOffscreenRenderpass(velocity.pass, VK_FORMAT_R32G32B32A32_SFLOAT, width, height, 1, VK_ATTACHMENT_LOAD_OP_CLEAR);
-		prepareOffscreenRenderpass(velocityMax.pass, VK_FORMAT_R32G32B32A32_SFLOAT, width, height, 1, VK_ATTACHMENT_LOAD_OP_CLEAR);
-		prepareOffscreenRenderpass(temproalReproj.pass, VK_FORMAT_R8G8B8A8_UNORM, width, height, 2, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		prepareFrameSync();
+
+		renderTargetWidth = std::max(static_cast<uint32_t>(width * renderScale + 0.5f), 1u);
+		renderTargetHeight = std::max(static_cast<uint32_t>(height * renderScale + 0.5f), 1u);
+		renderWidth = renderTargetWidth;
+		renderHeight = renderTargetHeight;
+		dynamicResolution.scale = renderScale;
+
+		// The velocity target is created first, the building pass renders into it with velocityMRT
+		VkFormat velocityTargetFormat = prepareVelocityFormat();
+		prepareResolvePrecision();
+		prepareRenderTargets(velocityTargetFormat);
+		prepareOffscreenRenderpass(velocity.pass, velocityTargetFormat, renderTargetWidth, renderTargetHeight, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		prepareBuilding(renderTargetWidth, renderTargetHeight, VK_FORMAT_R8G8B8A8_UNORM, velocityMRT ? velocityTargetFormat : VK_FORMAT_UNDEFINED);
+		if (velocityPrecision.enabled)
+			prepareVelocityPrecision();
+		prepareOffscreenRenderpass(temproalReproj.pass, VK_FORMAT_R8G8B8A8_UNORM, width, height, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		if (useSubpasses)
+			setupFrameBuffer();
 
 		setupDescriptorSetLayout();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		prepareRenderGraph();
+		if (cpuReference.enabled)
+			prepareCpuReference();
 
+		auto tPipelines = std::chrono::high_resolution_clock::now();
 		preparePipelines();
+		pipelineStartup.creationMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tPipelines).count();
+		// Every pipeline exists after startup, nothing is added to the cache later on
+		pipelineStartup.file.save(device, pipelineCache);
 		buildCommandBuffers();
+		pipelineStartup.startupMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+#if defined(TAA_HEADLESS)
+		// Replaces every pipeline, the command buffers are recorded again
+		measurePipelineStartup();
+		buildCommandBuffers();
+#endif
+		if (dynamicResolution.enabled && !profiler.enabled) {
+			std::cout << "-dynamicresolution needs GPU timestamps, keeping the render scale fixed" << std::endl;
+			dynamicResolution.enabled = false;
+		}
 		prepared = true;
 	}
 
@@ -1213,11 +3291,6 @@ public:
 			return;
 		draw();
 		current = 1 - current;
-		//	updateUniformBuffers();
-		updateTemproalUniformBuffers();
-
-		updateDescriptorSet();
-		buildCommandBuffers();
 
 	}
 
@@ -1228,6 +3301,146 @@ public:
 
 	}
 
+#if defined(TAA_HEADLESS)
+	virtual std::string gpuTimingsJson(const std::string &indent)
+	{
+		return profiler.enabled ? profiler.json(indent) : "";
+	}
+
+	virtual std::string settingsJson(const std::string &indent)
+	{
+		std::stringstream ss;
+		ss << indent << "\"computeResolve\": " << (useComputeResolve ? "true" : "false") << ",\n";
+		ss << indent << "\"asyncCompute\": " << (asyncCompute.enabled ? "true" : "false") << ",\n";
+		const ResolveVariant variant = activeResolveVariant();
+		ss << indent << "\"resolveMinMax\": \"" << resolveMinMaxName(variant.minMax) << "\",\n";
+		ss << indent << "\"resolveFastClip\": " << (variant.fastClip ? "true" : "false") << ",\n";
+		ss << indent << "\"resolveMotionBlur\": " << (variant.motionBlur ? "true" : "false") << ",\n";
+		ss << indent << "\"resolvePrecision\": \"" << (resolveFp16 ? "fp16" : "fp32") << "\",\n";
+		ss << indent << "\"shaderFloat16\": " << (shaderFloat16 ? "true" : "false") << ",\n";
+		ss << indent << "\"velocityMRT\": " << (velocityMRT ? "true" : "false") << ",\n";
+		ss << indent << "\"velocityFormat\": \"" << velocityFormatName() << "\",\n";
+		ss << indent << "\"framesInFlight\": " << framesInFlight << ",\n";
+		ss << indent << "\"instances\": " << instances.count << ",\n";
+		ss << indent << "\"meshFormat\": \"" << (meshLoad.mapped ? "taamesh" : "assimp") << "\",\n";
+		ss << indent << "\"meshVertices\": " << models.scene.vertexCount << ",\n";
+		ss << indent << "\"meshLoadMs\": " << meshLoad.ms << ",\n";
+		ss << indent << "\"velocityVertexBytes\": " << MeshFile::stride(MeshFile::sceneStreams()[0]) << ",\n";
+		ss << indent << "\"buildingVertexBytes\": " << MeshFile::stride(MeshFile::sceneStreams()[0]) + MeshFile::stride(MeshFile::sceneStreams()[1]) << ",\n";
+		ss << indent << "\"vertexAnimation\": " << (vertexAnimation.enabled ? "true" : "false") << ",\n";
+		ss << indent << "\"jitter\": \"" << frustumJitter.sequence.name << "\",\n";
+		ss << indent << "\"subpasses\": " << (useSubpasses ? "true" : "false") << ",\n";
+		ss << indent << "\"renderScale\": " << renderScale << ",\n";
+		ss << indent << "\"renderWidth\": " << renderWidth << ",\n";
+		ss << indent << "\"renderHeight\": " << renderHeight << ",\n";
+		ss << indent << "\"pipelineCache\": \"" << PipelineCacheFile::statusName(pipelineStartup.file.status()) << "\",\n";
+		ss << indent << "\"pipelineCacheBytes\": " << pipelineStartup.file.loadedSize() << ",\n";
+		ss << indent << "\"pipelineThreads\": " << pipelineStartup.threadsUsed << ",\n";
+		ss << indent << "\"pipelines\": " << pipelineStartup.pipelines << ",\n";
+		ss << indent << "\"pipelineCreationMs\": " << pipelineStartup.creationMs << ",\n";
+		ss << indent << "\"pipelineColdMs\": " << pipelineStartup.coldMs << ",\n";
+		ss << indent << "\"pipelineWarmMs\": " << pipelineStartup.warmMs << ",\n";
+		ss << indent << "\"startupMs\": " << pipelineStartup.startupMs << ",\n";
+		RenderTargetArena::Stats targetStats = renderTargets.stats();
+		ss << indent << "\"renderTargetImages\": " << targetStats.images << ",\n";
+		ss << indent << "\"renderTargetBlocks\": " << targetStats.blocks << ",\n";
+		ss << indent << "\"renderTargetAliasedImages\": " << targetStats.aliasedImages << ",\n";
+		ss << indent << "\"renderTargetDedicatedBytes\": " << targetStats.dedicatedBytes << ",\n";
+		ss << indent << "\"renderTargetArenaBytes\": " << targetStats.arenaBytes << ",\n";
+		const std::vector<std::string> graphPasses = renderGraph.passNames();
+		ss << indent << "\"renderGraphPasses\": [";
+		for (size_t p = 0; p < graphPasses.size(); p++) {
+			ss << (p == 0 ? "" : ", ") << "\"" << graphPasses[p] << "\"";
+		}
+		ss << "],\n";
+		ss << indent << "\"renderGraphCulledPasses\": " << renderGraph.culledPasses() << ",\n";
+		ss << indent << "\"renderGraphSegments\": " << renderGraph.segmentCount() << ",\n";
+		ss << indent << "\"renderGraphImageBarriers\": " << renderGraph.barrierCount(0);
+		if (dynamicResolution.enabled) {
+			ss << ",\n" << indent << "\"dynamicResolutionTargetMs\": " << dynamicResolution.targetMs;
+			ss << ",\n" << indent << "\"dynamicResolutionScale\": " << dynamicResolution.scale;
+			ss << ",\n" << indent << "\"dynamicResolutionChanges\": " << dynamicResolution.changes;
+		}
+		if (velocityPrecision.enabled) {
+			ss << ",\n" << indent << "\"velocityMaxErrorPx\": " << velocityPrecision.maxError;
+			ss << ",\n" << indent << "\"velocityErrorPixels\": " << velocityPrecision.errorPixels;
+		}
+		if (cpuReference.enabled) {
+			ss << ",\n" << indent << "\"cpuReferenceIsa\": \"" << TaaReference::isaName(cpuReference.reference->isa()) << "\"";
+			ss << ",\n" << indent << "\"cpuReferenceThreads\": " << cpuReference.reference->threadCount();
+			ss << ",\n" << indent << "\"cpuReferenceTolerance\": " << CPU_REFERENCE_TOLERANCE;
+			ss << ",\n" << indent << "\"cpuReferenceMaxDifference\": " << cpuReference.worstDifference;
+			ss << ",\n" << indent << "\"cpuReferenceFramesAboveTolerance\": " << cpuReference.framesAboveTolerance;
+			ss << ",\n" << indent << "\"cpuReferenceResolveMs\": " << cpuReference.resolveMs;
+			if (resolveFp16)
+				ss << ",\n" << indent << "\"cpuReferenceFp32MaxDifference\": " << cpuReference.fp32WorstDifference;
+		}
+		return ss.str();
+	}
+#else
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (profiler.enabled && overlay->header("GPU timings (ms)")) {
+			overlay->text("%-20s %6s %6s %6s %6s", "pass", "min", "avg", "p95", "p99");
+			for (uint32_t pass = 0; pass < PASS_COUNT; pass++) {
+				PassProfiler::Stats stats = profiler.stats(pass);
+				overlay->text("%-20s %6.3f %6.3f %6.3f %6.3f", profiler.names()[pass].c_str(), stats.min, stats.avg, stats.p95, stats.p99);
+			}
+			if (overlay->button("Dump CSV/JSON")) {
+				profiler.dump("taa_timings.csv", "taa_timings.json");
+			}
+		}
+		if (overlay->header("Settings")) {
+			// The compute resolve does not upsample, -asynccompute needs it
+			if (renderScale == 1.0f && !dynamicResolution.enabled && !asyncCompute.enabled && overlay->checkBox("Compute resolve", &useComputeResolve)) {
+				buildCommandBuffers();
+			}
+			// The compute resolve and the CPU reference only implement the default variant
+			if (!useComputeResolve && !cpuReference.enabled) {
+				bool changed = overlay->comboBox("Resolve min/max", &resolveVariant.minMax, { "3x3", "3x3 rounded", "4 tap varying" });
+				changed |= overlay->checkBox("Fast history clip", &resolveVariant.fastClip);
+				changed |= overlay->checkBox("Motion blur", &resolveVariant.motionBlur);
+				if (changed) {
+					temproalReproj.pipeline = resolvePipelines[resolveVariantIndex(resolveVariant)];
+					buildCommandBuffers();
+				}
+			}
+			else {
+				const ResolveVariant variant = activeResolveVariant();
+				overlay->text("Resolve variant: %s min/max%s%s", resolveMinMaxName(variant.minMax), variant.fastClip ? ", fast clip" : "", variant.motionBlur ? ", motion blur" : "");
+			}
+			overlay->text("Resolve colour math: %s", resolveFp16 ? "fp16" : "fp32");
+			overlay->text("Render resolution: %ux%u (%.2f)", renderWidth, renderHeight, (float)renderWidth / width);
+			if (dynamicResolution.enabled) {
+				overlay->text("Dynamic resolution: %.2f ms target, %.2f ms, %u changes", dynamicResolution.targetMs, dynamicResolution.averageMs, dynamicResolution.changes);
+			}
+			overlay->text("Velocity: %s, %s", velocityMRT ? "building pass MRT" : "separate pass", velocityFormatName());
+			overlay->text("Frames in flight: %u", framesInFlight);
+			overlay->text("Post chain: %s", asyncCompute.enabled ? "async compute queue" : "graphics queue");
+			overlay->text("Mesh: %u vertices, %s in %.1f ms", models.scene.vertexCount, meshLoad.mapped ? "mapped" : "imported", meshLoad.ms);
+			overlay->text("Vertex fetch: %u bytes velocity, %u bytes building", MeshFile::stride(MeshFile::sceneStreams()[0]), MeshFile::stride(MeshFile::sceneStreams()[0]) + MeshFile::stride(MeshFile::sceneStreams()[1]));
+			overlay->text("Instances: %u", instances.count);
+			if (vertexAnimation.enabled) {
+				overlay->text("Vertex animation: compute pre-pass, %u vertices", models.scene.vertexCount);
+			}
+			RenderTargetArena::Stats targetStats = renderTargets.stats();
+			overlay->text("Render targets: %.1f MB in %u blocks, %.1f MB one per image, %u aliased", targetStats.arenaBytes / 1048576.0f, targetStats.blocks, targetStats.dedicatedBytes / 1048576.0f, targetStats.aliasedImages);
+			overlay->text("Render graph: %u passes, %u culled, %u image barriers", static_cast<uint32_t>(renderGraph.passNames().size()), renderGraph.culledPasses(), renderGraph.barrierCount(0));
+			overlay->text("Startup: %.1f ms, %u pipelines in %.1f ms (%s cache)", pipelineStartup.startupMs, pipelineStartup.pipelines, pipelineStartup.creationMs, PipelineCacheFile::statusName(pipelineStartup.file.status()));
+			overlay->text("Jitter: %s, %u samples", frustumJitter.sequence.name, frustumJitter.sequence.count);
+			overlay->text("Resolve and quad: %s", useSubpasses ? "one render pass" : "two render passes");
+			if (velocityPrecision.enabled) {
+				overlay->text("Velocity error vs fp32: %.4f px max, %u px > 1/16", velocityPrecision.maxError, velocityPrecision.errorPixels);
+			}
+			if (cpuReference.enabled) {
+				overlay->text("CPU reference (%s, %.2f ms): %u max, %u px > %u", TaaReference::isaName(cpuReference.reference->isa()), cpuReference.resolveMs, cpuReference.maxDifference, cpuReference.pixelsAboveTolerance, CPU_REFERENCE_TOLERANCE);
+				if (resolveFp16)
+					overlay->text("fp16 vs fp32 reference: %u max, %u px > 1", cpuReference.fp32MaxDifference, cpuReference.fp32PixelsAboveOne);
+			}
+		}
+	}
+#endif
+
 
 };
 
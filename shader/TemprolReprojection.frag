@@ -0,0 +1,327 @@
+#version 450
+layout (binding = 0) uniform UBO {
+
+	vec4 _SinTime;
+	vec4 _FeedbackMin_Max_Mscale;
+	vec4 _JitterUV;
+	vec4 _RenderScale;// xy = render size / history size, zw = render size / building target size
+
+} ubo;
+layout (binding = 2) uniform sampler2D _MainTex;
+layout (binding = 3) uniform sampler2D _PrevTex;
+layout (binding = 4) uniform sampler2D _VelocityNeighborMax;
+// Dilated velocity (velocityDilate.comp): xy = uv velocity of the closest fragment in the 3x3
+// neighbourhood, z = its linear depth. Binding 1 is unused, only the dilation reads depth.
+layout (binding = 5) uniform sampler2D _VelocityBuffer;
+// The velocity tiles store uv velocity * VELOCITY_SCALE, 1 for float formats (see prepareVelocityFormat() in scenerendering.cpp)
+layout (constant_id = 0) const float VELOCITY_SCALE = 1.0;
+// Resolve variants, one pipeline each (see ResolveVariant in scenerendering.cpp). The defaults
+// are what TaaReference (taareference.hpp) computes.
+// Clip the history towards the centre of the neighbourhood box only, cheaper than the exact clip
+layout (constant_id = 1) const bool USE_OPTIMIZATIONS = false;
+// Neighbourhood min/max: 0 = 3x3, 1 = 3x3 blended with the 5 tap cross, 2 = 4 taps shrinking with subpixel motion
+layout (constant_id = 2) const int MINMAX_MODE = 1;
+// Blur along the neighbourhood max velocity where the history can't be trusted. There is a
+// single output, so the blurred colour also becomes the next history
+layout (constant_id = 3) const bool USE_MOTION_BLUR = false;
+// Colour precision. CMake compiles this source a second time with RESOLVE_FP16 defined
+// (TemprolReprojectionFp16.frag.spv, see -resolveprecision in scenerendering.cpp): the YCoCg
+// colours, their neighbourhood box, the clip and the feedback blend become float16_t, which
+// needs the shaderFloat16 feature. Texture coordinates, velocity and the dither noise stay
+// fp32, fp16 can't address a texel of a large target. Colour literals are written as cfloat()
+// so no operation gets promoted to fp32 (TaaReference emulates the same rounding).
+#ifdef RESOLVE_FP16
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#define cfloat float16_t
+#define cvec2 f16vec2
+#define cvec3 f16vec3
+#define cvec4 f16vec4
+#else
+#define cfloat float
+#define cvec2 vec2
+#define cvec3 vec3
+#define cvec4 vec4
+#endif
+
+const int MINMAX_3X3 = 0;
+const int MINMAX_3X3_ROUNDED = 1;
+const int MINMAX_4TAP_VARYING = 2;
+
+
+
+layout (location = 0) in vec2 ss_txc;
+layout (location = 0) out vec4 outFragColor;
+
+
+cvec3 RGB_YCoCg(cvec3 c)
+{
+	// Y = R/4 + G/2 + B/4
+	// Co = R/2 - B/2
+	// Cg = -R/4 + G/2 - B/4
+	return cvec3(
+			c.x/cfloat(4.0) + c.y/cfloat(2.0) + c.z/cfloat(4.0),
+			c.x/cfloat(2.0) - c.z/cfloat(2.0),
+		-c.x/cfloat(4.0) + c.y/cfloat(2.0) - c.z/cfloat(4.0)
+	);
+}
+cvec4 sample_color(sampler2D tex, vec2 uv)
+{
+
+	cvec4 c = cvec4(texture(tex, uv));
+	return cvec4(RGB_YCoCg(c.rgb), c.a);
+
+
+}
+// Dynamic resolution renders into the top left _RenderScale.zw of the building targets,
+// map output uv there and keep bilinear taps off the texels outside of the viewport
+vec2 render_uv(vec2 uv)
+{
+	return uv * ubo._RenderScale.zw;
+}
+vec2 clamp_render_uv(vec2 tex_uv)
+{
+	return min(tex_uv, ubo._RenderScale.zw - 0.5 / vec2(textureSize(_MainTex, 0)));
+}
+cvec4 sample_render_color(vec2 tex_uv)
+{
+	return sample_color(_MainTex, clamp_render_uv(tex_uv));
+}
+cvec4 clip_aabb(cvec3 aabb_min, cvec3 aabb_max, cvec4 p, cvec4 q)
+{
+	cfloat FLT_EPS = cfloat(0.0001);
+	if (USE_OPTIMIZATIONS)
+	{
+		// note: only clips towards aabb center (but fast!)
+		cvec3 p_clip = cfloat(0.5) * (aabb_max + aabb_min);
+		cvec3 e_clip = cfloat(0.5) * (aabb_max - aabb_min) + FLT_EPS;
+
+		cvec4 v_clip = q - cvec4(p_clip, p.w);
+		cvec3 v_unit = v_clip.xyz / e_clip;
+		cvec3 a_unit = abs(v_unit);
+		cfloat ma_unit = max(a_unit.x, max(a_unit.y, a_unit.z));
+
+		if (ma_unit > cfloat(1.0))
+			return cvec4(p_clip, p.w) + v_clip / ma_unit;
+		else
+			return q;// point inside aabb
+	}
+	else
+	{
+		cvec4 r = q - p;
+		cvec3 rmax = aabb_max - p.xyz;
+		cvec3 rmin = aabb_min - p.xyz;
+
+		const cfloat eps = FLT_EPS;
+
+		if (r.x > rmax.x + eps)
+			r *= (rmax.x / r.x);
+		if (r.y > rmax.y + eps)
+			r *= (rmax.y / r.y);
+		if (r.z > rmax.z + eps)
+			r *= (rmax.z / r.z);
+
+		if (r.x < rmin.x - eps)
+			r *= (rmin.x / r.x);
+		if (r.y < rmin.y - eps)
+			r *= (rmin.y / r.y);
+		if (r.z < rmin.z - eps)
+			r *= (rmin.z / r.z);
+
+		return p + r;
+	}
+}
+
+cvec4 temporal_reprojection(vec2 ss_txc, vec2 ss_vel, float vs_dist)
+	{
+
+		vec2 uv = ss_txc-ubo._JitterUV.xy;
+		vec2 tex_uv = render_uv(uv);
+
+		cvec4 texel0 = sample_render_color(tex_uv);
+
+		cvec4 texel1 = sample_color(_PrevTex, ss_txc - ss_vel);
+
+		vec2 du =vec2( 1.0/textureSize(_MainTex, 0).x, 0.0);
+		vec2 dv =vec2(0.0,1.0/  textureSize(_MainTex, 0).y);
+
+		cvec4 cmin, cmax, cavg;
+		if (MINMAX_MODE == MINMAX_4TAP_VARYING)// this is the method used in v2 (PDTemporalReprojection2)
+		{
+			float FLT_EPS = 0.0001f;
+			const float _SubpixelThreshold = 0.5;
+			const float _GatherBase = 0.5;
+			const float _GatherSubpixelMotion = 0.1666;
+
+			vec2 texel_vel = ss_vel * ubo._RenderScale.xy * textureSize(_PrevTex, 0);
+			float texel_vel_mag = length(texel_vel) * vs_dist;
+			float k_subpixel_motion = clamp(_SubpixelThreshold / (FLT_EPS + texel_vel_mag),0.0,1.0);
+			float k_min_max_support = _GatherBase + _GatherSubpixelMotion * k_subpixel_motion;
+
+			vec2 ss_offset01 = k_min_max_support * vec2(-du.x, dv.y);
+			vec2 ss_offset11 = k_min_max_support * vec2(du.x, dv.y);
+			cvec4 c00 = sample_render_color(tex_uv - ss_offset11);
+			cvec4 c10 = sample_render_color(tex_uv - ss_offset01);
+			cvec4 c01 = sample_render_color(tex_uv + ss_offset01);
+			cvec4 c11 = sample_render_color(tex_uv + ss_offset11);
+
+			cmin = min(c00, min(c10, min(c01, c11)));
+			cmax = max(c00, max(c10, max(c01, c11)));
+			cavg = (c00 + c10 + c01 + c11) / cfloat(4.0);
+		}
+		else
+		{
+			cvec4 ctl = sample_render_color(tex_uv - dv - du);
+			cvec4 ctc = sample_render_color(tex_uv - dv);
+			cvec4 ctr = sample_render_color(tex_uv - dv + du);
+			cvec4 cml = sample_render_color(tex_uv - du);
+			cvec4 cmc = sample_render_color(tex_uv);
+			cvec4 cmr = sample_render_color(tex_uv + du);
+			cvec4 cbl = sample_render_color(tex_uv + dv - du);
+			cvec4 cbc = sample_render_color(tex_uv + dv);
+			cvec4 cbr = sample_render_color(tex_uv + dv + du);
+
+			cmin = min(ctl, min(ctc, min(ctr, min(cml, min(cmc, min(cmr, min(cbl, min(cbc, cbr))))))));
+			cmax = max(ctl, max(ctc, max(ctr, max(cml, max(cmc, max(cmr, max(cbl, max(cbc, cbr))))))));
+
+			cavg = (ctl + ctc + ctr + cml + cmc + cmr + cbl + cbc + cbr) / cfloat(9.0);
+
+			if (MINMAX_MODE == MINMAX_3X3_ROUNDED)
+			{
+				cvec4 cmin5 = min(ctc, min(cml, min(cmc, min(cmr, cbc))));
+				cvec4 cmax5 = max(ctc, max(cml, max(cmc, max(cmr, cbc))));
+				cvec4 cavg5 = (ctc + cml + cmc + cmr + cbc) / cfloat(5.0);
+				cmin = cfloat(0.5) * (cmin + cmin5);
+				cmax = cfloat(0.5) * (cmax + cmax5);
+				cavg = cfloat(0.5) * (cavg + cavg5);
+			}
+		}
+
+		cvec2 chroma_extent = cvec2(cfloat(0.25 * 0.5) * (cmax.r - cmin.r));
+		cvec2 chroma_center = cvec2(texel0.gb);
+		cmin.yz = chroma_center - chroma_extent;
+		cmax.yz = chroma_center + chroma_extent;
+		cavg.yz = chroma_center;
+
+		texel1 = clip_aabb(cmin.xyz, cmax.xyz, clamp(cavg, cmin, cmax), texel1);
+
+		cfloat lum0 = texel0.r;
+		cfloat lum1 = texel1.r;
+
+		cfloat unbiased_diff = abs(lum0 - lum1) / max(lum0, max(lum1, cfloat(0.2)));
+		cfloat unbiased_weight = cfloat(1.0) - unbiased_diff;
+		cfloat unbiased_weight_sqr = unbiased_weight * unbiased_weight;
+		cfloat k_feedback = cfloat(mix(ubo._FeedbackMin_Max_Mscale.x, ubo._FeedbackMin_Max_Mscale.y, float(unbiased_weight_sqr)));
+
+		// Upsampling: the current frame only has a sample every 1/_RenderScale output pixels, trust it
+		// by how close the nearest jittered sample lies to this pixel (Blackman-Harris fit).
+		// No history on the first frame, max feedback is 0 there
+		if ((ubo._RenderScale.x < 1.0 || ubo._RenderScale.y < 1.0) && ubo._FeedbackMin_Max_Mscale.y > 0.0)
+		{
+			vec2 renderSize = ubo._RenderScale.xy * vec2(textureSize(_PrevTex, 0));
+			vec2 texel = uv * renderSize - 0.5;
+			vec2 offset = (texel - floor(texel + 0.5)) / ubo._RenderScale.xy;
+			float sample_weight = exp(-2.29 * dot(offset, offset));
+			k_feedback = cfloat(1.0 - (1.0 - float(k_feedback)) * sample_weight);
+		}
+
+		// output
+		return texel0+(texel1-texel0)*k_feedback;
+	}
+
+cvec3 YCoCg_RGB(cvec3 c)
+{
+	// R = Y + Co - Cg
+	// G = Y + Cg
+	// B = Y - Co - Cg
+
+	return clamp(cvec3(
+		c.x + c.y - c.z,
+		c.x + c.z,
+		c.x - c.y - c.z
+	),cfloat(0.0), cfloat(1.0));
+}
+cvec4 resolve_color(cvec4 c)
+{
+
+	return cvec4(YCoCg_RGB(c.rgb).rgb, c.a);
+
+}
+vec4 PDnrand4( vec2 n ) {
+	return fract( sin(dot(n.xy, vec2(12.9898f, 78.233f)))* vec4(43758.5453f, 28001.8384f, 50849.4141f, 12996.89f) );
+}
+vec4 PDsrand4( vec2 n ) {
+	return PDnrand4( n ) * 2 - 1;
+}
+
+float PDnrand( vec2 n ) {
+	return fract( sin(dot(n.xy,vec2(12.9898f, 78.233f)))* 43758.5453f );
+}
+float PDsrand( vec2 n ) {
+	return PDnrand( n ) * 2 - 1;
+}
+cvec4 sample_color_motion( vec2 uv, vec2 ss_vel)
+	{
+		const vec2 v = 0.5 * ss_vel * ubo._RenderScale.zw;
+		const int taps = 3;// on either side!
+
+		float srand = PDsrand(uv + ubo._SinTime.xx);
+		vec2 vtap = v / taps;
+		vec2 pos0 = uv + vtap * (0.5 * srand);
+		cvec4 accu = cvec4(0.0);
+		cfloat wsum = cfloat(0.0);
+
+
+		for (int i = -taps; i <= taps; i++)
+		{
+			cfloat w = cfloat(1.0);// box
+			//float w = taps - abs(i) + 1;// triangle
+			//float w = 1.0 / (1 + abs(i));// pointy triangle
+			accu += w * sample_render_color(pos0 + i * vtap);
+			wsum += w;
+		}
+
+		return accu / wsum;
+	}
+// _VelocityNeighborMax holds one texel per velocity tile, fetch the tile covering uv
+vec4 sample_velocity_max(vec2 uv)
+{
+	ivec2 size = textureSize(_VelocityNeighborMax, 0);
+	return texelFetch(_VelocityNeighborMax, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1), 0);
+}
+void main()
+{
+
+	vec2 uv = clamp_render_uv(render_uv(ss_txc-ubo._JitterUV.xy));
+
+	vec3 dilated = texture(_VelocityBuffer, uv).xyz;
+	vec2 ss_vel = dilated.xy;
+	float vs_dist = dilated.z;
+
+	// temporal resolve
+	cvec4 color_temporal = temporal_reprojection(ss_txc, ss_vel, vs_dist);
+
+	// prepare outputs
+	cvec4 to_buffer = resolve_color(color_temporal);
+
+	if (USE_MOTION_BLUR)
+	{
+		float _MotionScale=1.0;
+
+		vec2 ss_vel_max = _MotionScale * sample_velocity_max(uv).xy / VELOCITY_SCALE;
+
+		// Velocity length in output pixels
+		float vel_mag = length(ss_vel_max * vec2(textureSize(_PrevTex, 0)));
+		const float vel_trust_full = 2.0;
+		const float vel_trust_none = 15.0;
+		const float vel_trust_span = vel_trust_none - vel_trust_full;
+		float trust = 1.0 - clamp(vel_mag - vel_trust_full, 0.0, vel_trust_span) / vel_trust_span;
+
+		cvec4 color_motion = sample_color_motion( render_uv(ss_txc - ubo._JitterUV.xy), ss_vel_max);
+
+		to_buffer = resolve_color(mix(color_motion, color_temporal, cfloat(trust)));
+	}
+
+	vec4 noise4 = PDsrand4(ss_txc + ubo._SinTime.x + 0.6959174) / 510.0;
+
+	outFragColor=clamp((vec4(to_buffer) + noise4),0.0,1.0);
+}
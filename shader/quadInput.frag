@@ -0,0 +1,14 @@
+#version 450
+
+// quad.frag for -subpasses: the history target was written by the previous subpass of the
+// same render pass and is read back at the current pixel instead of being sampled
+layout (input_attachment_index = 0, binding = 0) uniform subpassInput colorMap;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	outFragColor = subpassLoad(colorMap);
+}
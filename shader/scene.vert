@@ -1,17 +1,28 @@
 #version 450
 
 layout (location = 0) in vec4 inPos;
-layout (location = 1) in vec3 inNormal;
+layout (location = 1) in vec2 inNormal;
 layout (location = 2) in vec2 inUV;
 
 
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
-	mat4 model;
 	mat4 view;
 } ubo;
 
+struct InstanceTransform
+{
+	mat4 curr;
+	mat4 prev;
+};
+
+// Model matrices of every instance, this and the previous frame
+layout (std430, binding = 2) readonly buffer Instances
+{
+	InstanceTransform instances[];
+};
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outLightVec;
@@ -22,23 +33,33 @@ out gl_PerVertex
 	vec4 gl_Position;
 };
 
+// Octahedral encoded unit normal, see MeshFile::octEncode
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
 void main() 
 {
 	vec4 lightPos=vec4(0,0,0,1);
+	mat4 model = instances[gl_InstanceIndex].curr;
 	// Normal in view space
-	mat3 normalMatrix = transpose(inverse(mat3(ubo.view * ubo.model)));
-	outNormal = normalMatrix * inNormal;
+	mat3 normalMatrix = transpose(inverse(mat3(ubo.view * model)));
+	outNormal = normalMatrix * octDecode(inNormal);
 
 	
 	outUV = inUV;
 
-	mat4 modelView = ubo.view * ubo.model;
+	mat4 modelView = ubo.view * model;
 
 	
 
 	
 	vec3 lPos =  lightPos.xyz;
-	outLightVec = lPos -  vec3(ubo.view * ubo.model * inPos).xyz;
+	outLightVec = lPos -  vec3(ubo.view * model * inPos).xyz;
 	
 	gl_Position = ubo.projection * modelView * vec4(inPos.xyz, 1.0);
 	
@@ -0,0 +1,30 @@
+#version 450
+// scene.frag plus the velocity output of velocityMotion.frag. The depth test already
+// keeps only the visible surface, no depth map lookup or discard is needed.
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inLightVec;
+layout (location = 3) in vec3 cs_xy_curr;
+layout (location = 4) in vec3 cs_xy_prev;
+
+// Velocity targets store uv velocity * VELOCITY_SCALE, 1 for float formats (see prepareVelocityFormat() in scenerendering.cpp)
+layout (constant_id = 0) const float VELOCITY_SCALE = 1.0;
+
+layout (location = 0) out vec4 outFragColor;
+layout (location = 1) out vec4 outVelocity;
+
+void main() 
+{
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+
+	vec3 diffuse = max(dot(N, L), 0.5) *vec3(1.0);
+	outFragColor = vec4(diffuse,1.0);
+
+	// compute velocity in ndc
+	vec2 ndc_curr = cs_xy_curr.xy / cs_xy_curr.z;
+	vec2 ndc_prev = cs_xy_prev.xy / cs_xy_prev.z;
+
+	outVelocity = vec4(VELOCITY_SCALE * 0.5 * (ndc_curr - ndc_prev), 0.0, 0.0);
+}
@@ -0,0 +1,75 @@
+#version 450
+// scene.vert that also passes the clip positions velocityMotion.vert computes, so the
+// building pass writes velocity as a second color attachment
+
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec2 inUV;
+// Same as inPos unless a vertex animation pre-pass provides last frame's positions
+layout (location = 3) in vec4 inPrevPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+} ubo;
+
+layout (binding = 1) uniform VelocityUBO 
+{
+	mat4 _CurrVP;
+	mat4 _PrevVP;
+} velocityUbo;
+
+struct InstanceTransform
+{
+	mat4 curr;
+	mat4 prev;
+};
+
+// Model matrices of every instance, this and the previous frame
+layout (std430, binding = 2) readonly buffer Instances
+{
+	InstanceTransform instances[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outLightVec;
+layout (location = 3) out vec3 cs_xy_curr;
+layout (location = 4) out vec3 cs_xy_prev;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+// Octahedral encoded unit normal, see MeshFile::octEncode
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main() 
+{
+	vec4 lightPos=vec4(0,0,0,1);
+	InstanceTransform instance = instances[gl_InstanceIndex];
+	// Normal in view space
+	mat3 normalMatrix = transpose(inverse(mat3(ubo.view * instance.curr)));
+	outNormal = normalMatrix * octDecode(inNormal);
+
+	outUV = inUV;
+
+	mat4 modelView = ubo.view * instance.curr;
+
+	vec3 lPos =  lightPos.xyz;
+	outLightVec = lPos -  vec3(ubo.view * instance.curr * inPos).xyz;
+
+	vec4 ws_pos = vec4(inPos.xyz, 1.0);
+	cs_xy_curr = (velocityUbo._CurrVP * instance.curr * ws_pos).xyw;
+	cs_xy_prev = (velocityUbo._PrevVP * instance.prev * vec4(inPrevPos.xyz, 1.0)).xyw;
+
+	gl_Position = ubo.projection * modelView * ws_pos;
+}
@@ -1,5 +1,7 @@
 #version 450
 layout (binding = 1) uniform sampler2D depthMap;
+// Velocity targets store uv velocity * VELOCITY_SCALE, 1 for float formats (see prepareVelocityFormat() in scenerendering.cpp)
+layout (constant_id = 0) const float VELOCITY_SCALE = 1.0;
 
 layout (location = 0) in vec4 cs_pos;
 layout (location = 1) in vec4 ss_pos;
@@ -34,7 +36,7 @@ void main()
 	vec2 ndc_prev = cs_xy_prev.xy / cs_xy_prev.z;
 
 	
-	outFragColor = vec4( 0.01*0.5*(ndc_curr - ndc_prev), 0.0, 0.0);
+	outFragColor = vec4(VELOCITY_SCALE * 0.5 * (ndc_curr - ndc_prev), 0.0, 0.0);
 	
 	
 }
\ No newline at end of file
@@ -1,14 +1,24 @@
 #version 450
+// Only the position streams are bound
 layout (location = 0) in vec4 inPos;
-layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec2 inUV;
+// Same as inPos unless a vertex animation pre-pass provides last frame's positions
+layout (location = 3) in vec4 inPrevPos;
 layout (binding = 0) uniform UBO 
 {
 	mat4 _CurrVP;
-	mat4 _CurrM;
 	mat4 _PrevVP;
-	mat4 _PrevM;
 } ubo;
+struct InstanceTransform
+{
+	mat4 curr;
+	mat4 prev;
+};
+
+// Model matrices of every instance, this and the previous frame
+layout (std430, binding = 2) readonly buffer Instances
+{
+	InstanceTransform instances[];
+};
 layout (location = 0) out vec4 cs_pos;
 layout (location = 1) out vec4 ss_pos;
 layout (location = 2) out vec3 cs_xy_curr;
@@ -24,13 +34,14 @@ out gl_PerVertex
 void main() 
 {
 	const float occlusion_bias = 0.03;
+	InstanceTransform instance = instances[gl_InstanceIndex];
 	vec4 ws_pos_curr = inPos;
-	vec4 ws_pos_prev = inPos;
-	cs_pos = ubo._CurrVP*ubo._CurrM*ws_pos_curr;
+	vec4 ws_pos_prev = inPrevPos;
+	cs_pos = ubo._CurrVP*instance.curr*ws_pos_curr;
 	ss_pos = cs_pos/cs_pos.w;
-	ss_pos.z = -(ubo._CurrVP*ubo._CurrM*ws_pos_curr).z - occlusion_bias;// COMPUTE_EYEDEPTH
+	ss_pos.z = -(ubo._CurrVP*instance.curr*ws_pos_curr).z - occlusion_bias;// COMPUTE_EYEDEPTH
 	cs_xy_curr = cs_pos.xyw;
-	cs_xy_prev =(ubo._PrevVP*ubo._PrevM*ws_pos_prev).xyw;
+	cs_xy_prev =(ubo._PrevVP*instance.prev*ws_pos_prev).xyw;
 	gl_Position = cs_pos;
 
 }
@@ -9,6 +9,8 @@ layout (binding = 0) uniform UBO {
 } ubo;
 
 layout (binding = 1) uniform sampler2D depthMap;
+// Velocity targets store uv velocity * VELOCITY_SCALE, 1 for float formats (see prepareVelocityFormat() in scenerendering.cpp)
+layout (constant_id = 0) const float VELOCITY_SCALE = 1.0;
 
 layout (location = 0) in vec2 inUV;
 
@@ -43,7 +45,7 @@ void main()
 	
 	vec2 ss_vel = inUV - rp_ss_txc;
 	
-	outFragColor = vec4(0.5*ss_vel+0.5,0.0,1.0);
+	outFragColor = vec4(VELOCITY_SCALE * ss_vel, 0.0, 1.0);
 	
 	//outFragColor = vec4(vec3(1.0-LinearizeDepth(depth)), 1.0);
 	
@@ -0,0 +1,180 @@
+/*
+* Convergence of the jitter sequences (jittersequence.hpp)
+*
+* Point samples an analytic image (hard edged disc, thin rotated stripes) at the pixel
+* centre plus the jitter offset of each frame and compares the accumulation against a
+* 32x32 supersampled reference. Reports the RMSE of the running mean after 1 to 64 frames,
+* the frames needed to stay below --threshold and the steady state RMSE of an exponential
+* history with --feedback, the way the TAA resolve blends. Output is JSON like taa_bench.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "jittersequence.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Settings {
+	uint32_t width = 256;
+	uint32_t height = 256;
+	uint32_t frames = 64;
+	float threshold = 0.05f;
+	float feedback = 0.9f;
+	std::string output;
+};
+
+// Supersampling rate of the reference per axis
+constexpr uint32_t REFERENCE_RATE = 32;
+
+float shade(float x, float y, uint32_t width, uint32_t height)
+{
+	const float dx = x - 0.5f * width;
+	const float dy = y - 0.5f * height;
+	if (dx * dx + dy * dy < 0.09f * width * height)
+		return 0.9f;
+	// Stripes a bit over one pixel wide, aliased by any regular pattern
+	return (std::fmod(std::abs(0.8f * x + 0.6f * y), 2.6f) < 1.3f) ? 0.7f : 0.1f;
+}
+
+float rmse(const std::vector<float> &a, const std::vector<float> &b)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		const double d = a[i] - b[i];
+		sum += d * d;
+	}
+	return static_cast<float>(std::sqrt(sum / a.size()));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	Settings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if ((arg == "-w" || arg == "-width" || arg == "--width") && hasValue) {
+			settings.width = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-h" || arg == "-height" || arg == "--height") && hasValue) {
+			settings.height = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-f" || arg == "--frames") && hasValue) {
+			settings.frames = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if (arg == "--threshold" && hasValue) {
+			settings.threshold = static_cast<float>(atof(argv[++i]));
+		}
+		else if (arg == "--feedback" && hasValue) {
+			settings.feedback = static_cast<float>(atof(argv[++i]));
+		}
+		else if ((arg == "-o" || arg == "--output") && hasValue) {
+			settings.output = argv[++i];
+		}
+	}
+	settings.width = std::max(settings.width, 1u);
+	settings.height = std::max(settings.height, 1u);
+	settings.frames = std::max(settings.frames, 1u);
+	settings.feedback = std::min(std::max(settings.feedback, 0.0f), 0.999f);
+
+	const size_t pixels = static_cast<size_t>(settings.width) * settings.height;
+	std::vector<float> reference(pixels);
+	for (uint32_t y = 0; y < settings.height; y++)
+	{
+		for (uint32_t x = 0; x < settings.width; x++)
+		{
+			float sum = 0.0f;
+			for (uint32_t sy = 0; sy < REFERENCE_RATE; sy++)
+			{
+				for (uint32_t sx = 0; sx < REFERENCE_RATE; sx++)
+				{
+					sum += shade(x + (sx + 0.5f) / REFERENCE_RATE, y + (sy + 0.5f) / REFERENCE_RATE, settings.width, settings.height);
+				}
+			}
+			reference[static_cast<size_t>(y) * settings.width + x] = sum / (REFERENCE_RATE * REFERENCE_RATE);
+		}
+	}
+
+	std::stringstream json;
+	json << "{\n";
+	json << "\t\"width\": " << settings.width << ",\n";
+	json << "\t\"height\": " << settings.height << ",\n";
+	json << "\t\"frames\": " << settings.frames << ",\n";
+	json << "\t\"threshold\": " << settings.threshold << ",\n";
+	json << "\t\"feedback\": " << settings.feedback << ",\n";
+	json << "\t\"results\": [";
+	std::vector<float> frame(pixels), mean(pixels), history(pixels);
+	for (int p = 0; p < JITTER_PATTERN_COUNT; p++)
+	{
+		const JitterSequence sequence = jitterSequence(static_cast<JitterPattern>(p));
+		std::vector<float> meanError, historyError;
+		for (uint32_t f = 0; f < settings.frames; f++)
+		{
+			const float *offset = sequence.points[f % sequence.count];
+			for (uint32_t y = 0; y < settings.height; y++)
+			{
+				for (uint32_t x = 0; x < settings.width; x++)
+				{
+					frame[static_cast<size_t>(y) * settings.width + x] = shade(x + 0.5f + offset[0], y + 0.5f + offset[1], settings.width, settings.height);
+				}
+			}
+			for (size_t i = 0; i < pixels; i++)
+			{
+				mean[i] += (frame[i] - mean[i]) / (f + 1);
+				// No history on the first frame, like _FeedbackMin_Max_Mscale
+				history[i] = (f == 0) ? frame[i] : frame[i] + (history[i] - frame[i]) * settings.feedback;
+			}
+			meanError.push_back(rmse(mean, reference));
+			historyError.push_back(rmse(history, reference));
+		}
+
+		// First frame count after which the running mean stays below the threshold
+		int32_t framesToConverge = -1;
+		for (uint32_t f = settings.frames; f > 0 && meanError[f - 1] < settings.threshold; f--)
+		{
+			framesToConverge = static_cast<int32_t>(f);
+		}
+		// Exponential history never settles, average it over the last cycle of the pattern
+		const uint32_t window = std::min(sequence.count, settings.frames);
+		float steadyState = 0.0f;
+		for (uint32_t f = settings.frames - window; f < settings.frames; f++)
+		{
+			steadyState += historyError[f] / window;
+		}
+
+		json << (p == 0 ? "\n" : ",\n");
+		json << "\t\t{ \"pattern\": \"" << sequence.name << "\"";
+		json << ", \"points\": " << sequence.count;
+		json << ", \"framesToConverge\": " << framesToConverge;
+		for (uint32_t f = 1; f <= settings.frames; f *= 2)
+		{
+			json << ", \"rmse" << f << "\": " << meanError[f - 1];
+		}
+		json << ", \"historyRmse\": " << steadyState << " }";
+		std::fill(mean.begin(), mean.end(), 0.0f);
+	}
+	json << "\n\t]\n}\n";
+
+	if (settings.output.empty())
+	{
+		std::cout << json.str();
+	}
+	else
+	{
+		std::ofstream file(settings.output);
+		file << json.str();
+	}
+	return 0;
+}
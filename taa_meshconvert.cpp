@@ -0,0 +1,67 @@
+/*
+* Converts a model to the binary mesh format of meshfile.hpp
+*
+* The vertices are written in the streams of MeshFile::sceneStreams (positions, packed normals
+* and UVs), so scenerendering and taa_bench can map the file and upload it without parsing.
+* The triangles and vertices are reordered for the vertex caches unless --no-optimize is given.
+*
+*   taa_meshconvert --input model.obj --output model.taamesh [--no-optimize]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "meshfile.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[])
+{
+	std::string input, output;
+	bool optimize = true;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if ((arg == "-i" || arg == "--input") && hasValue) {
+			input = argv[++i];
+		}
+		else if ((arg == "-o" || arg == "--output") && hasValue) {
+			output = argv[++i];
+		}
+		else if (arg == "--no-optimize") {
+			optimize = false;
+		}
+	}
+	if (input.empty() || output.empty())
+	{
+		std::cerr << "usage: taa_meshconvert --input model.obj --output model.taamesh [--no-optimize]" << std::endl;
+		return 1;
+	}
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+	MeshFile::Data data;
+	std::string error;
+	if (!MeshFile::import(input, MeshFile::sceneStreams(), data, error))
+	{
+		std::cerr << "Could not load " << input << ": " << error << std::endl;
+		return 1;
+	}
+	double importMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	const float acmrBefore = MeshFile::acmr(data.indices, data.vertexCount);
+	if (optimize)
+		MeshFile::optimize(data);
+	if (!MeshFile::write(output, data))
+	{
+		std::cerr << "Could not write " << output << std::endl;
+		return 1;
+	}
+	std::cout << output << ": " << data.vertexCount << " vertices, " << data.indices.size() << " indices, import " << importMs << " ms" << std::endl;
+	std::cout << "  bytes per vertex:";
+	for (const auto &stream : data.streams)
+		std::cout << " " << MeshFile::stride(stream.layout);
+	std::cout << " (" << 8 * sizeof(float) << " interleaved as floats)" << std::endl;
+	std::cout << "  ACMR (FIFO 16): " << acmrBefore << " -> " << MeshFile::acmr(data.indices, data.vertexCount) << std::endl;
+	return 0;
+}
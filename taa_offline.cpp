@@ -0,0 +1,631 @@
+/*
+* Offline TAA over captured frame sequences
+*
+* Streams colour, velocity and optional depth frames from disk, resolves them with the CPU
+* reference of TemprolReprojection.frag (taareference.hpp) and writes the resolved
+* frames as raw RGBA8. Reading, resolving and writing run on their own threads and hand a
+* fixed set of preallocated frame slots around, so memory stays constant whatever the
+* length of the sequence and nothing is allocated per frame.
+*
+* Inputs, little endian:
+*   raw:       --color (RGBA8), --velocity (RG32F uv velocity) and optionally --depth (R32F)
+*              files holding --width x --height frames back to back
+*   container: --input file.taac, chunked:
+*                header  "TAAC", uint32 version (1), width, height, float velocityScale
+*                chunks  char tag[4], uint32 size, size bytes of payload
+*                  "FRAM"  starts a frame: float jitterU, jitterV (uv), float sinTime
+*                  "COLR"  width * height RGBA8
+*                  "VELO"  width * height * (2 or 4) floats, uv velocity * velocityScale
+*                  "DPTH"  width * height floats, optional
+*                unknown chunks are skipped
+*
+* With depth, the reader dilates the velocity by closest depth in a 3x3 neighbourhood like
+* velocityDilate.comp before the resolve, without it the resolve reads the centre velocity.
+* The output of every frame is the history of the next one, the first frame is passed
+* through like in the sample (feedback 0).
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "taareference.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Largest frame side accepted, like maxImageDimension2D of most Vulkan devices
+const uint32_t maxDimension = 16384;
+
+// width * height * bytesPerPixel, false if it does not fit into size_t
+bool frameBytes(uint32_t width, uint32_t height, size_t bytesPerPixel, size_t &bytes)
+{
+	const size_t pixels = static_cast<size_t>(width) * height;
+	if (width > maxDimension || height > maxDimension || (bytesPerPixel != 0 && pixels > SIZE_MAX / bytesPerPixel))
+		return false;
+	bytes = pixels * bytesPerPixel;
+	return true;
+}
+
+struct Settings {
+	std::string input;
+	std::string color, velocity, depth;
+	std::string output;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t threads = 0;
+	// Frames queued between two stages
+	uint32_t slots = 3;
+	float feedbackMin = 0.88f;
+	float feedbackMax = 0.97f;
+	TaaReference::Isa isa = TaaReference::ISA_COUNT;
+};
+
+struct InputSlot {
+	uint32_t index;
+	std::vector<uint8_t> color;
+	std::vector<float> velocity;
+	std::vector<float> depth;
+	uint32_t velocityStride;
+	bool hasDepth;
+	// Closest depth dilated uv velocity, 2 floats per pixel, only with depth
+	std::vector<float> dilatedVelocity;
+	TaaReference::Params params;
+};
+
+struct OutputSlot {
+	uint32_t index;
+	std::vector<uint8_t> color;
+};
+
+// Hands slots from one stage to the next, pop() fails once closed and drained
+template <typename T>
+class SlotQueue
+{
+public:
+	void push(T *slot)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots.push_back(slot);
+		}
+		ready.notify_one();
+	}
+
+	bool pop(T *&slot)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ready.wait(lock, [&] { return closed || !slots.empty(); });
+		if (slots.empty())
+			return false;
+		slot = slots.front();
+		slots.pop_front();
+		return true;
+	}
+
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		ready.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<T *> slots;
+	bool closed = false;
+};
+
+bool readExactly(FILE *file, void *data, size_t size)
+{
+	return fread(data, 1, size, file) == size;
+}
+
+class FrameSource
+{
+public:
+	virtual ~FrameSource() {}
+	// Fills the slot with the next frame, false at the end of the sequence or on errors
+	virtual bool read(InputSlot &slot) = 0;
+	virtual uint32_t velocityStride() const = 0;
+	virtual bool hasDepth() const = 0;
+	std::string error;
+	uint64_t bytesRead = 0;
+};
+
+// Separate raw files, one frame after the other
+class RawSource : public FrameSource
+{
+public:
+	RawSource(const Settings &settings)
+		: width(settings.width), height(settings.height)
+	{
+		color = fopen(settings.color.c_str(), "rb");
+		velocity = fopen(settings.velocity.c_str(), "rb");
+		depth = settings.depth.empty() ? nullptr : fopen(settings.depth.c_str(), "rb");
+		if (!color || !velocity || (!settings.depth.empty() && !depth))
+			error = "cannot open the raw input files";
+	}
+
+	~RawSource()
+	{
+		for (FILE *file : { color, velocity, depth })
+		{
+			if (file)
+				fclose(file);
+		}
+	}
+
+	bool read(InputSlot &slot)
+	{
+		const size_t pixels = static_cast<size_t>(width) * height;
+		if (!readExactly(color, slot.color.data(), pixels * 4))
+			return false;
+		if (!readExactly(velocity, slot.velocity.data(), pixels * 2 * sizeof(float)) ||
+			(depth && !readExactly(depth, slot.depth.data(), pixels * sizeof(float))))
+		{
+			error = "velocity or depth file ends before the color file";
+			return false;
+		}
+		bytesRead += pixels * (4 + 2 * sizeof(float) + (depth ? sizeof(float) : 0));
+		// Raw captures carry no uniforms: no jitter, dither advancing like the sample at 60 fps
+		slot.params = TaaReference::Params();
+		slot.params.sinTime = frames++ / 60.0f / 8.0f;
+		return true;
+	}
+
+	uint32_t velocityStride() const { return 2; }
+	bool hasDepth() const { return depth != nullptr; }
+
+private:
+	uint32_t width, height;
+	uint32_t frames = 0;
+	FILE *color = nullptr;
+	FILE *velocity = nullptr;
+	FILE *depth = nullptr;
+};
+
+// Chunked container, see the top of this file
+class ContainerSource : public FrameSource
+{
+public:
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	ContainerSource(const std::string &path)
+	{
+		file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			error = "cannot open " + path;
+			return;
+		}
+		char magic[4];
+		uint32_t header[3];
+		if (!readExactly(file, magic, 4) || memcmp(magic, "TAAC", 4) != 0 ||
+			!readExactly(file, header, sizeof(header)) || !readExactly(file, &velocityScale, sizeof(float)))
+		{
+			error = path + " is not a TAAC container";
+			return;
+		}
+		if (header[0] != 1)
+		{
+			error = "unsupported TAAC version " + std::to_string(header[0]);
+			return;
+		}
+		width = header[1];
+		height = header[2];
+		size_t planeBytes = 0;
+		if (width == 0 || height == 0 || !frameBytes(width, height, sizeof(float), planeBytes))
+		{
+			error = "invalid TAAC frame size " + std::to_string(width) + " x " + std::to_string(height);
+			width = height = 0;
+			return;
+		}
+		// Chunk layout is fixed for the whole file, the first frame tells what it holds
+		const long start = ftell(file);
+		bool frame = false;
+		while (nextChunk())
+		{
+			if (tag == "FRAM")
+			{
+				if (frame)
+					break;
+				frame = true;
+			}
+			else if (frame && tag == "VELO")
+			{
+				// Whole floats per pixel only, anything else is rejected below
+				stride = (chunkSize % planeBytes == 0) ? static_cast<uint32_t>(chunkSize / planeBytes) : 0;
+			}
+			else if (frame && tag == "DPTH")
+			{
+				depth = true;
+			}
+			skipChunk();
+		}
+		fseek(file, start, SEEK_SET);
+		bytesRead = start;
+		if (!frame)
+			error = path + " holds no frames";
+		else if (stride != 2 && stride != 4)
+			error = "VELO chunks must hold 2 or 4 floats per pixel";
+		else if (!frameBytes(width, height, 4, colorBytes) || !frameBytes(width, height, stride * sizeof(float), velocityBytes))
+			error = path + " frames do not fit into memory";
+		depthBytes = planeBytes;
+	}
+
+	~ContainerSource()
+	{
+		if (file)
+			fclose(file);
+	}
+
+	bool read(InputSlot &slot)
+	{
+		bool frame = false, color = false, velocity = false, hasDepthChunk = false;
+		while (pending || nextChunk())
+		{
+			pending = false;
+			if (tag == "FRAM")
+			{
+				if (frame)
+				{
+					// Start of the next frame, keep the chunk for the next call
+					pending = true;
+					break;
+				}
+				float values[3];
+				if (chunkSize < sizeof(values) || !readExactly(file, values, sizeof(values)))
+					return fail("truncated FRAM chunk");
+				chunkSize -= sizeof(values);
+				skipChunk();
+				slot.params = TaaReference::Params();
+				slot.params.jitterUV[0] = values[0];
+				slot.params.jitterUV[1] = values[1];
+				slot.params.sinTime = values[2];
+				slot.params.velocityScale = velocityScale;
+				frame = true;
+			}
+			else if (frame && tag == "COLR" && chunkSize == colorBytes)
+			{
+				if (!readExactly(file, slot.color.data(), chunkSize))
+					return fail("truncated COLR chunk");
+				color = true;
+			}
+			else if (frame && tag == "VELO" && chunkSize == velocityBytes)
+			{
+				if (!readExactly(file, slot.velocity.data(), chunkSize))
+					return fail("truncated VELO chunk");
+				velocity = true;
+			}
+			else if (frame && tag == "DPTH" && depth && chunkSize == depthBytes)
+			{
+				if (!readExactly(file, slot.depth.data(), chunkSize))
+					return fail("truncated DPTH chunk");
+				hasDepthChunk = true;
+			}
+			else
+			{
+				skipChunk();
+			}
+		}
+		if (!frame)
+			return false;
+		if (!color || !velocity || (depth && !hasDepthChunk))
+			return fail("frame without COLR, VELO or DPTH chunk");
+		return true;
+	}
+
+	uint32_t velocityStride() const { return stride; }
+	bool hasDepth() const { return depth; }
+
+private:
+	FILE *file = nullptr;
+	float velocityScale = 1.0f;
+	uint32_t stride = 0;
+	bool depth = false;
+	// Payload size of the COLR, VELO and DPTH chunks
+	size_t colorBytes = 0, velocityBytes = 0, depthBytes = 0;
+	// Current chunk header, pending when read but not consumed yet
+	std::string tag;
+	uint32_t chunkSize = 0;
+	bool pending = false;
+
+	bool nextChunk()
+	{
+		char header[4];
+		if (!readExactly(file, header, 4) || !readExactly(file, &chunkSize, sizeof(chunkSize)))
+			return false;
+		tag.assign(header, 4);
+		bytesRead += 8 + chunkSize;
+		return true;
+	}
+
+	void skipChunk()
+	{
+		fseek(file, chunkSize, SEEK_CUR);
+	}
+
+	bool fail(const char *message)
+	{
+		error = message;
+		return false;
+	}
+};
+
+// velocityDilate.comp: every pixel takes the velocity of the closest fragment in its 3x3
+// neighbourhood, the first of equally close ones. Taps past the border clamp to it. The
+// result is plain uv velocity, velocityScale is divided out like on the GPU.
+void dilateVelocity(InputSlot &slot, uint32_t width, uint32_t height)
+{
+	const float scale = 1.0f / slot.params.velocityScale;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			size_t closest = static_cast<size_t>(y) * width + x;
+			float dmin = 2.0f;
+			for (int32_t dy = -1; dy <= 1; dy++)
+			{
+				const size_t row = static_cast<size_t>(std::min(std::max(static_cast<int32_t>(y) + dy, 0), static_cast<int32_t>(height) - 1)) * width;
+				for (int32_t dx = -1; dx <= 1; dx++)
+				{
+					const size_t i = row + std::min(std::max(static_cast<int32_t>(x) + dx, 0), static_cast<int32_t>(width) - 1);
+					if (slot.depth[i] < dmin)
+					{
+						dmin = slot.depth[i];
+						closest = i;
+					}
+				}
+			}
+			float *out = &slot.dilatedVelocity[(static_cast<size_t>(y) * width + x) * 2];
+			out[0] = slot.velocity[closest * slot.velocityStride + 0] * scale;
+			out[1] = slot.velocity[closest * slot.velocityStride + 1] * scale;
+		}
+	}
+	slot.params.velocityScale = 1.0f;
+}
+
+bool parseIsa(const std::string &name, TaaReference::Isa &isa)
+{
+	for (int i = 0; i < TaaReference::ISA_COUNT; i++)
+	{
+		if (name == TaaReference::isaName(static_cast<TaaReference::Isa>(i)))
+		{
+			isa = static_cast<TaaReference::Isa>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	Settings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if ((arg == "-i" || arg == "--input") && hasValue) {
+			settings.input = argv[++i];
+		}
+		else if (arg == "--color" && hasValue) {
+			settings.color = argv[++i];
+		}
+		else if (arg == "--velocity" && hasValue) {
+			settings.velocity = argv[++i];
+		}
+		else if (arg == "--depth" && hasValue) {
+			settings.depth = argv[++i];
+		}
+		else if ((arg == "-o" || arg == "--output") && hasValue) {
+			settings.output = argv[++i];
+		}
+		else if ((arg == "-w" || arg == "-width" || arg == "--width") && hasValue) {
+			settings.width = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-h" || arg == "-height" || arg == "--height") && hasValue) {
+			settings.height = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-t" || arg == "--threads") && hasValue) {
+			settings.threads = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if (arg == "--slots" && hasValue) {
+			settings.slots = std::max(static_cast<uint32_t>(strtol(argv[++i], nullptr, 10)), 1u);
+		}
+		else if (arg == "--feedback" && i + 2 < argc) {
+			settings.feedbackMin = strtof(argv[++i], nullptr);
+			settings.feedbackMax = strtof(argv[++i], nullptr);
+		}
+		else if (arg == "--isa" && hasValue) {
+			if (!parseIsa(argv[++i], settings.isa)) {
+				std::cerr << "unknown instruction set " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+	}
+	if (settings.output.empty() || (settings.input.empty() && (settings.color.empty() || settings.velocity.empty())))
+	{
+		std::cerr << "usage: taa_offline (--input file.taac | --color file --velocity file [--depth file] --width w --height h) --output file" << std::endl;
+		std::cerr << "       [--threads n] [--slots n] [--isa reference|sse4.1|avx2] [--feedback min max]" << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<FrameSource> source;
+	uint32_t width = settings.width;
+	uint32_t height = settings.height;
+	if (!settings.input.empty())
+	{
+		ContainerSource *container = new ContainerSource(settings.input);
+		source.reset(container);
+		width = container->width;
+		height = container->height;
+	}
+	else
+	{
+		source.reset(new RawSource(settings));
+	}
+	size_t frameSize = 0;
+	if (source->error.empty() && (width == 0 || height == 0 || !frameBytes(width, height, 4 * sizeof(float), frameSize)))
+		source->error = "--width and --height are required, at most " + std::to_string(maxDimension);
+	if (!source->error.empty())
+	{
+		std::cerr << source->error << std::endl;
+		return 1;
+	}
+	FILE *output = fopen(settings.output.c_str(), "wb");
+	if (!output)
+	{
+		std::cerr << "cannot open " << settings.output << std::endl;
+		return 1;
+	}
+
+	TaaReference reference(settings.threads);
+	reference.setIsa(settings.isa == TaaReference::ISA_COUNT ? TaaReference::bestIsa() : settings.isa);
+
+	// Every buffer of the run is allocated here
+	const size_t pixels = static_cast<size_t>(width) * height;
+	std::vector<InputSlot> inputSlots(settings.slots);
+	std::vector<OutputSlot> outputSlots(settings.slots);
+	SlotQueue<InputSlot> freeInputs, decoded;
+	SlotQueue<OutputSlot> freeOutputs, resolved;
+	for (auto &slot : inputSlots)
+	{
+		slot.color.resize(pixels * 4);
+		slot.velocity.resize(pixels * source->velocityStride());
+		slot.depth.resize(source->hasDepth() ? pixels : 0);
+		slot.dilatedVelocity.resize(source->hasDepth() ? pixels * 2 : 0);
+		slot.velocityStride = source->velocityStride();
+		slot.hasDepth = source->hasDepth();
+		freeInputs.push(&slot);
+	}
+	for (auto &slot : outputSlots)
+	{
+		slot.color.resize(pixels * 4);
+		freeOutputs.push(&slot);
+	}
+	std::vector<uint8_t> history(pixels * 4);
+
+	double decodeMs = 0.0, resolveMs = 0.0, encodeMs = 0.0;
+	uint64_t bytesWritten = 0;
+	bool writeFailed = false;
+	auto now = [] { return std::chrono::high_resolution_clock::now(); };
+	auto elapsedMs = [](std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+	auto tStart = now();
+
+	std::thread reader([&] {
+		InputSlot *slot;
+		uint32_t index = 0;
+		while (freeInputs.pop(slot))
+		{
+			auto t0 = now();
+			const bool read = source->read(*slot);
+			if (read && slot->hasDepth)
+				dilateVelocity(*slot, width, height);
+			decodeMs += elapsedMs(t0, now());
+			if (!read)
+				break;
+			slot->index = index++;
+			decoded.push(slot);
+		}
+		decoded.close();
+	});
+
+	std::thread writer([&] {
+		OutputSlot *slot;
+		while (resolved.pop(slot))
+		{
+			auto t0 = now();
+			if (!writeFailed && fwrite(slot->color.data(), 1, slot->color.size(), output) != slot->color.size())
+				writeFailed = true;
+			encodeMs += elapsedMs(t0, now());
+			bytesWritten += slot->color.size();
+			freeOutputs.push(slot);
+		}
+	});
+
+	// Resolve on this thread, the reference spreads every frame over its own workers
+	uint32_t frames = 0;
+	InputSlot *input;
+	while (decoded.pop(input))
+	{
+		OutputSlot *slot;
+		if (!freeOutputs.pop(slot))
+			break;
+
+		TaaReference::Frame frame;
+		frame.width = width;
+		frame.height = height;
+		frame.color = input->color.data();
+		// Depth only feeds the dilation, like on the GPU
+		frame.velocity = input->hasDepth ? input->dilatedVelocity.data() : input->velocity.data();
+		frame.velocityStride = input->hasDepth ? 2 : input->velocityStride;
+		// The first frame has no history
+		frame.history = (input->index == 0) ? input->color.data() : history.data();
+		TaaReference::Params params = input->params;
+		params.feedbackMin = (input->index == 0) ? 0.0f : settings.feedbackMin;
+		params.feedbackMax = (input->index == 0) ? 0.0f : settings.feedbackMax;
+
+		auto t0 = now();
+		reference.resolve(frame, params, slot->color.data());
+		memcpy(history.data(), slot->color.data(), history.size());
+		resolveMs += elapsedMs(t0, now());
+
+		slot->index = input->index;
+		freeInputs.push(input);
+		resolved.push(slot);
+		frames++;
+	}
+	// Unblocks the reader if it stopped waiting for a slot
+	freeInputs.close();
+	resolved.close();
+	reader.join();
+	writer.join();
+	fclose(output);
+	const double totalMs = elapsedMs(tStart, now());
+
+	if (!source->error.empty() || writeFailed)
+	{
+		std::cerr << (writeFailed ? "writing " + settings.output + " failed" : source->error) << " after " << frames << " frames" << std::endl;
+		return 1;
+	}
+
+	std::stringstream json;
+	json << "{\n";
+	json << "\t\"width\": " << width << ",\n";
+	json << "\t\"height\": " << height << ",\n";
+	json << "\t\"frames\": " << frames << ",\n";
+	json << "\t\"isa\": \"" << TaaReference::isaName(reference.isa()) << "\",\n";
+	json << "\t\"threads\": " << reference.threadCount() << ",\n";
+	json << "\t\"slots\": " << settings.slots << ",\n";
+	json << "\t\"totalMs\": " << totalMs << ",\n";
+	json << "\t\"fps\": " << frames * 1000.0 / totalMs << ",\n";
+	json << "\t\"readMBps\": " << source->bytesRead / 1.0e6 / (totalMs / 1000.0) << ",\n";
+	json << "\t\"writeMBps\": " << bytesWritten / 1.0e6 / (totalMs / 1000.0) << ",\n";
+	// Busy time per stage, the largest one bounds the throughput
+	json << "\t\"stageMs\": { \"decode\": " << decodeMs << ", \"resolve\": " << resolveMs << ", \"encode\": " << encodeMs << " }\n";
+	json << "}\n";
+	std::cout << json.str();
+	return 0;
+}
@@ -0,0 +1,257 @@
+/*
+* Throughput benchmark of the TAA CPU reference
+*
+* Resolves synthetic frames (hard edged shapes over gradients, history shifted by the
+* velocity) with every instruction set the CPU supports and a range of thread counts.
+* Reports megapixels per second, per core, and the largest difference of each vectorised
+* kernel against ISA_REFERENCE. The fp16 colour math of the RESOLVE_FP16 shaders is emulated
+* over the 16 Halton jitter offsets and compared against fp32, its largest difference is the
+* error bound of -resolveprecision fp16. Output is JSON like taa_bench.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "taareference.hpp"
+#include "jittersequence.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Settings {
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t frames = 20;
+	// 0: 1, 2, 4, ... up to every hardware thread
+	uint32_t threads = 0;
+	std::string output;
+};
+
+struct SyntheticFrame {
+	std::vector<uint8_t> color, history;
+	std::vector<float> velocity;
+};
+
+uint8_t unorm8(float v)
+{
+	return static_cast<uint8_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+SyntheticFrame makeFrame(uint32_t width, uint32_t height, float velocityScale)
+{
+	SyntheticFrame frame;
+	frame.color.resize(static_cast<size_t>(width) * height * 4);
+	frame.history.resize(frame.color.size());
+	frame.velocity.resize(static_cast<size_t>(width) * height * 2);
+	auto shade = [&](float x, float y, float *rgb) {
+		// Gradient background with rotated stripes and a disc, both with aliased edges
+		const float u = x / width;
+		const float v = y / height;
+		const bool stripe = std::fmod(std::abs(0.8f * x + 0.6f * y), 24.0f) < 12.0f;
+		const float dx = x - 0.5f * width;
+		const float dy = y - 0.5f * height;
+		const bool disc = dx * dx + dy * dy < 0.09f * width * height;
+		rgb[0] = disc ? 0.9f : (stripe ? 0.8f * u : 0.1f);
+		rgb[1] = disc ? 0.3f : (stripe ? 0.6f : 0.2f + 0.5f * v);
+		rgb[2] = disc ? 0.2f : (stripe ? 0.3f * v : 0.7f);
+	};
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const size_t i = static_cast<size_t>(y) * width + x;
+			// Disc moves right by 3 px, the background by half a pixel down
+			const float dx = x - 0.5f * width;
+			const float dy = y - 0.5f * height;
+			const bool disc = dx * dx + dy * dy < 0.09f * width * height;
+			const float motionX = disc ? 3.0f : 0.0f;
+			const float motionY = disc ? 0.0f : 0.5f;
+			float rgb[3];
+			shade(static_cast<float>(x), static_cast<float>(y), rgb);
+			float previous[3];
+			shade(x - motionX, y - motionY, previous);
+			for (int c = 0; c < 3; c++)
+			{
+				frame.color[i * 4 + c] = unorm8(rgb[c]);
+				frame.history[i * 4 + c] = unorm8(previous[c]);
+			}
+			frame.color[i * 4 + 3] = 255;
+			frame.history[i * 4 + 3] = 255;
+			frame.velocity[i * 2 + 0] = motionX / width * velocityScale;
+			frame.velocity[i * 2 + 1] = motionY / height * velocityScale;
+		}
+	}
+	return frame;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	Settings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if ((arg == "-w" || arg == "-width" || arg == "--width") && hasValue) {
+			settings.width = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-h" || arg == "-height" || arg == "--height") && hasValue) {
+			settings.height = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-f" || arg == "--frames") && hasValue) {
+			settings.frames = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-t" || arg == "--threads") && hasValue) {
+			settings.threads = static_cast<uint32_t>(strtol(argv[++i], nullptr, 10));
+		}
+		else if ((arg == "-o" || arg == "--output") && hasValue) {
+			settings.output = argv[++i];
+		}
+	}
+	settings.width = std::max(settings.width, 1u);
+	settings.height = std::max(settings.height, 1u);
+	settings.frames = std::max(settings.frames, 1u);
+
+	const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<uint32_t> threadCounts;
+	if (settings.threads > 0)
+	{
+		threadCounts.push_back(settings.threads);
+	}
+	else
+	{
+		for (uint32_t t = 1; t < hardwareThreads; t *= 2)
+		{
+			threadCounts.push_back(t);
+		}
+		threadCounts.push_back(hardwareThreads);
+	}
+
+	TaaReference::Params params;
+	params.jitterUV[0] = 0.3125f / settings.width;
+	params.jitterUV[1] = -0.1875f / settings.height;
+	params.sinTime = 0.25f;
+	params.velocityScale = 4.0f;
+	const SyntheticFrame frame = makeFrame(settings.width, settings.height, params.velocityScale);
+	TaaReference::Frame input;
+	input.width = settings.width;
+	input.height = settings.height;
+	input.color = frame.color.data();
+	input.history = frame.history.data();
+	input.velocity = frame.velocity.data();
+
+	const size_t outputSize = frame.color.size();
+	std::vector<uint8_t> golden(outputSize), output(outputSize);
+	{
+		TaaReference reference(threadCounts.back());
+		reference.resolve(input, params, golden.data());
+	}
+
+	const double megapixels = static_cast<double>(settings.width) * settings.height / 1.0e6;
+	std::stringstream json;
+	json << "{\n";
+	json << "\t\"width\": " << settings.width << ",\n";
+	json << "\t\"height\": " << settings.height << ",\n";
+	json << "\t\"frames\": " << settings.frames << ",\n";
+	json << "\t\"hardwareThreads\": " << hardwareThreads << ",\n";
+	json << "\t\"results\": [";
+	bool first = true;
+	for (int isa = TaaReference::ISA_REFERENCE; isa < TaaReference::ISA_COUNT; isa++)
+	{
+		if (!TaaReference::supported(static_cast<TaaReference::Isa>(isa)))
+			continue;
+		for (uint32_t threads : threadCounts)
+		{
+			TaaReference reference(threads);
+			reference.setIsa(static_cast<TaaReference::Isa>(isa));
+			// First frame sizes the planes and scratch, keep it out of the timing
+			reference.resolve(input, params, output.data());
+			uint32_t pixelsAboveTolerance = 0;
+			const uint32_t maxDifference = TaaReference::compare(golden.data(), output.data(), settings.width, settings.height, 1, &pixelsAboveTolerance);
+
+			std::vector<double> frameTimes;
+			for (uint32_t f = 0; f < settings.frames; f++)
+			{
+				auto tStart = std::chrono::high_resolution_clock::now();
+				reference.resolve(input, params, output.data());
+				auto tEnd = std::chrono::high_resolution_clock::now();
+				frameTimes.push_back(std::chrono::duration<double, std::milli>(tEnd - tStart).count());
+			}
+			std::sort(frameTimes.begin(), frameTimes.end());
+			const double medianMs = frameTimes[frameTimes.size() / 2];
+			const double mpxPerSecond = megapixels / (medianMs / 1000.0);
+			const uint32_t cores = std::min(threads, hardwareThreads);
+
+			json << (first ? "\n" : ",\n");
+			first = false;
+			json << "\t\t{ \"isa\": \"" << TaaReference::isaName(static_cast<TaaReference::Isa>(isa)) << "\"";
+			json << ", \"threads\": " << threads;
+			json << ", \"medianMs\": " << medianMs;
+			json << ", \"minMs\": " << frameTimes.front();
+			json << ", \"megapixelsPerSecond\": " << mpxPerSecond;
+			json << ", \"megapixelsPerSecondPerCore\": " << mpxPerSecond / cores;
+			json << ", \"maxDifference\": " << maxDifference;
+			json << ", \"pixelsAboveOne\": " << pixelsAboveTolerance << " }";
+		}
+	}
+	json << "\n\t],\n";
+
+	// fp16 against fp32, both on ISA_REFERENCE with the jitter and dither of a full sequence
+	{
+		TaaReference reference(threadCounts.back());
+		const JitterSequence sequence = jitterSequence(JITTER_HALTON_16);
+		std::vector<uint8_t> halfOutput(outputSize);
+		uint32_t maxDifference = 0;
+		uint64_t pixelsAboveOne = 0;
+		uint64_t differenceSum = 0;
+		std::vector<double> frameTimes;
+		for (uint32_t f = 0; f < sequence.count; f++)
+		{
+			TaaReference::Params frameParams = params;
+			frameParams.jitterUV[0] = sequence.points[f][0] / settings.width;
+			frameParams.jitterUV[1] = sequence.points[f][1] / settings.height;
+			frameParams.sinTime = std::sin(0.25f * f);
+			reference.resolve(input, frameParams, golden.data());
+			frameParams.halfPrecision = true;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			reference.resolve(input, frameParams, halfOutput.data());
+			frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+
+			uint32_t above = 0;
+			maxDifference = std::max(maxDifference, TaaReference::compare(golden.data(), halfOutput.data(), settings.width, settings.height, 1, &above));
+			pixelsAboveOne += above;
+			for (size_t i = 0; i < outputSize; i++)
+			{
+				differenceSum += static_cast<uint32_t>(std::abs(golden[i] - halfOutput[i]));
+			}
+		}
+		std::sort(frameTimes.begin(), frameTimes.end());
+		json << "\t\"halfPrecision\": { \"frames\": " << sequence.count;
+		json << ", \"threads\": " << reference.threadCount();
+		json << ", \"emulatedMedianMs\": " << frameTimes[frameTimes.size() / 2];
+		json << ", \"maxDifference\": " << maxDifference;
+		json << ", \"meanDifference\": " << static_cast<double>(differenceSum) / (static_cast<double>(outputSize) * sequence.count);
+		json << ", \"pixelsAboveOne\": " << pixelsAboveOne << " }\n";
+	}
+	json << "}\n";
+
+	if (settings.output.empty())
+	{
+		std::cout << json.str();
+	}
+	else
+	{
+		std::ofstream file(settings.output);
+		file << json.str();
+	}
+	return 0;
+}
@@ -0,0 +1,102 @@
+/*
+* Regression test of the vectorised TAA CPU reference kernels
+*
+* Resolves a fixed seeded frame with every instruction set the CPU supports and fails if any
+* of them differs from ISA_REFERENCE by more than 1/255. The frame has an odd width and a
+* height that is not a multiple of the band height, so row tails and the last partial band
+* are covered, and runs on 1 and several threads.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "taareference.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const uint32_t width = 333;
+const uint32_t height = 77;
+const uint32_t tolerance = 1;
+
+struct TestFrame {
+	std::vector<uint8_t> color, history;
+	std::vector<float> velocity;
+};
+
+// Noise with flat patches, so both clipped and unclipped history show up
+TestFrame makeFrame(uint32_t velocityStride)
+{
+	std::mt19937 random(20240611u);
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_real_distribution<float> motion(-4.0f, 4.0f);
+	TestFrame frame;
+	const size_t pixels = static_cast<size_t>(width) * height;
+	frame.color.resize(pixels * 4);
+	frame.history.resize(pixels * 4);
+	frame.velocity.resize(pixels * velocityStride);
+	for (size_t i = 0; i < pixels; i++)
+	{
+		const bool flat = ((i % width) / 8 + (i / width) / 8) % 3 == 0;
+		for (int c = 0; c < 4; c++)
+		{
+			frame.color[i * 4 + c] = static_cast<uint8_t>(flat ? 64 * c : byte(random));
+			frame.history[i * 4 + c] = static_cast<uint8_t>(byte(random));
+		}
+		frame.velocity[i * velocityStride + 0] = motion(random) / width;
+		frame.velocity[i * velocityStride + 1] = motion(random) / height;
+	}
+	return frame;
+}
+
+} // namespace
+
+int main()
+{
+	TaaReference::Params params;
+	params.jitterUV[0] = 0.3125f / width;
+	params.jitterUV[1] = -0.1875f / height;
+	params.sinTime = 0.4794f;
+
+	bool failed = false;
+	for (uint32_t velocityStride : { 2u, 4u })
+	{
+		const TestFrame input = makeFrame(velocityStride);
+		TaaReference::Frame frame;
+		frame.width = width;
+		frame.height = height;
+		frame.color = input.color.data();
+		frame.history = input.history.data();
+		frame.velocity = input.velocity.data();
+		frame.velocityStride = velocityStride;
+
+		std::vector<uint8_t> golden(static_cast<size_t>(width) * height * 4);
+		TaaReference reference(1);
+		reference.setIsa(TaaReference::ISA_REFERENCE);
+		reference.resolve(frame, params, golden.data());
+
+		for (uint32_t threads : { 1u, 4u })
+		{
+			TaaReference kernels(threads);
+			for (int i = 0; i < TaaReference::ISA_COUNT; i++)
+			{
+				const TaaReference::Isa isa = static_cast<TaaReference::Isa>(i);
+				if (!TaaReference::supported(isa))
+					continue;
+				kernels.setIsa(isa);
+				std::vector<uint8_t> output(golden.size());
+				kernels.resolve(frame, params, output.data());
+				uint32_t pixelsAboveTolerance = 0;
+				const uint32_t difference = TaaReference::compare(golden.data(), output.data(), width, height, tolerance, &pixelsAboveTolerance);
+				const bool ok = difference <= tolerance;
+				std::cout << (ok ? "ok   " : "FAIL ") << TaaReference::isaName(isa) << ", " << threads << " threads, velocity stride " << velocityStride
+					<< ": max difference " << difference << ", " << pixelsAboveTolerance << " pixels above " << tolerance << std::endl;
+				failed |= !ok;
+			}
+		}
+	}
+	return failed ? 1 : 0;
+}
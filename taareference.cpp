@@ -0,0 +1,646 @@
+/*
+* CPU reference of the TAA resolve
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "taareference.hpp"
+#include "taareference_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(TAA_REFERENCE_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// fp16 value nearest to f (ties to even) as a float, subnormals included
+inline float roundHalf(float f)
+{
+	if (!std::isfinite(f))
+		return f;
+	// Below the smallest normal fp16 every value is a multiple of 2^-24
+	if (std::abs(f) < 6.10351562e-5f)
+		return std::nearbyint(f * 16777216.0f) / 16777216.0f;
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	bits += 0xfffu + ((bits >> 13) & 1u);
+	bits &= ~0x1fffu;
+	memcpy(&f, &bits, sizeof(f));
+	return std::abs(f) > 65504.0f ? std::copysign(INFINITY, f) : f;
+}
+
+// float16_t of the RESOLVE_FP16 shaders. Every operation rounds its fp32 result, which is the
+// correctly rounded fp16 result for + - * / (24 >= 2 * 11 + 2 mantissa bits)
+struct Half {
+	float v;
+	Half() = default;
+	explicit Half(float f) : v(roundHalf(f)) {}
+	explicit operator float() const { return v; }
+};
+
+inline Half operator+(Half a, Half b) { return Half(a.v + b.v); }
+inline Half operator-(Half a, Half b) { return Half(a.v - b.v); }
+inline Half operator*(Half a, Half b) { return Half(a.v * b.v); }
+inline Half operator/(Half a, Half b) { return Half(a.v / b.v); }
+inline Half operator-(Half a) { return Half(-a.v); }
+inline bool operator<(Half a, Half b) { return a.v < b.v; }
+inline bool operator>(Half a, Half b) { return a.v > b.v; }
+inline Half abs1(Half a) { return Half(std::abs(a.v)); }
+inline float abs1(float a) { return std::abs(a); }
+
+// Just enough of vec4 to transliterate TemprolReprojection.frag, T is the colour precision
+template <typename T>
+struct vec4 {
+	T x, y, z, w;
+};
+typedef vec4<float> float4;
+
+template <typename T> inline vec4<T> operator+(const vec4<T> &a, const vec4<T> &b) { return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; }
+template <typename T> inline vec4<T> operator-(const vec4<T> &a, const vec4<T> &b) { return { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; }
+template <typename T> inline vec4<T> operator*(const vec4<T> &a, T s) { return { a.x * s, a.y * s, a.z * s, a.w * s }; }
+template <typename T> inline vec4<T> operator/(const vec4<T> &a, T s) { return { a.x / s, a.y / s, a.z / s, a.w / s }; }
+template <typename T> inline vec4<T> min4(const vec4<T> &a, const vec4<T> &b) { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z), std::min(a.w, b.w) }; }
+template <typename T> inline vec4<T> max4(const vec4<T> &a, const vec4<T> &b) { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w) }; }
+template <typename T> inline vec4<T> clamp4(const vec4<T> &a, const vec4<T> &lo, const vec4<T> &hi) { return min4(max4(a, lo), hi); }
+template <typename T> inline T clamp1(T a, T lo, T hi) { return std::min(std::max(a, lo), hi); }
+inline float fract(float a) { return a - std::floor(a); }
+
+// The cvec4(...) conversions of the shaders
+template <typename T> inline vec4<T> fromFloat4(const float4 &a) { return { T(a.x), T(a.y), T(a.z), T(a.w) }; }
+template <typename T> inline float4 toFloat4(const vec4<T> &a) { return { static_cast<float>(a.x), static_cast<float>(a.y), static_cast<float>(a.z), static_cast<float>(a.w) }; }
+
+// Bilinear, clamp to edge, normalized coordinates like colorsampler
+struct Texture {
+	uint32_t width, height;
+	float4 (*fetch)(const Texture &texture, int32_t x, int32_t y);
+	const void *data;
+	uint32_t stride;
+};
+
+float4 fetchRGBA8(const Texture &texture, int32_t x, int32_t y)
+{
+	const uint8_t *texel = static_cast<const uint8_t *>(texture.data) + (static_cast<size_t>(y) * texture.width + x) * 4;
+	return { texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f };
+}
+
+float4 fetchFloat(const Texture &texture, int32_t x, int32_t y)
+{
+	const float *texel = static_cast<const float *>(texture.data) + (static_cast<size_t>(y) * texture.width + x) * texture.stride;
+	float4 value = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float *components = &value.x;
+	for (uint32_t i = 0; i < std::min(texture.stride, 4u); i++)
+	{
+		components[i] = texel[i];
+	}
+	return value;
+}
+
+float4 texture(const Texture &tex, float u, float v)
+{
+	const float tx = u * tex.width - 0.5f;
+	const float ty = v * tex.height - 0.5f;
+	const float fx = std::floor(tx);
+	const float fy = std::floor(ty);
+	const float wx = tx - fx;
+	const float wy = ty - fy;
+	const int32_t maxX = static_cast<int32_t>(tex.width) - 1;
+	const int32_t maxY = static_cast<int32_t>(tex.height) - 1;
+	// Clamp before the conversion, coordinates far outside the image would overflow it
+	const int32_t x0 = static_cast<int32_t>(clamp1(fx, -1.0f, static_cast<float>(tex.width)));
+	const int32_t y0 = static_cast<int32_t>(clamp1(fy, -1.0f, static_cast<float>(tex.height)));
+	const int32_t xa = std::min(std::max(x0, 0), maxX);
+	const int32_t xb = std::min(std::max(x0 + 1, 0), maxX);
+	const int32_t ya = std::min(std::max(y0, 0), maxY);
+	const int32_t yb = std::min(std::max(y0 + 1, 0), maxY);
+	const float4 t00 = tex.fetch(tex, xa, ya);
+	const float4 t01 = tex.fetch(tex, xb, ya);
+	const float4 t10 = tex.fetch(tex, xa, yb);
+	const float4 t11 = tex.fetch(tex, xb, yb);
+	const float4 top = t00 + (t01 - t00) * wx;
+	const float4 bottom = t10 + (t11 - t10) * wx;
+	return top + (bottom - top) * wy;
+}
+
+struct Shader {
+	Texture cameraDepthTexture, mainTex, prevTex, velocityBuffer;
+	bool hasDepth;
+	TaaReference::Params ubo;
+};
+
+float LinearizeDepth(float depth)
+{
+	const float n = 1.0f;
+	const float f = 128.0f;
+	return (n * f) / (-f + depth * (f - n)) / f;
+}
+
+float4 find_closest_fragment_3x3(const Shader &shader, float u, float v)
+{
+	const float ddx = 1.0f / shader.cameraDepthTexture.width;
+	const float ddy = 1.0f / shader.cameraDepthTexture.height;
+	float4 dmin = { -1.0f, -1.0f, texture(shader.cameraDepthTexture, u - ddx, v - ddy).x, 0.0f };
+	for (int32_t dy = -1; dy <= 1; dy++)
+	{
+		for (int32_t dx = -1; dx <= 1; dx++)
+		{
+			const float depth = texture(shader.cameraDepthTexture, u + dx * ddx, v + dy * ddy).x;
+			if (dmin.z > depth)
+			{
+				dmin = { static_cast<float>(dx), static_cast<float>(dy), depth, 0.0f };
+			}
+		}
+	}
+	return { u + ddx * dmin.x, v + ddy * dmin.y, dmin.z, 0.0f };
+}
+
+template <typename T>
+vec4<T> RGB_YCoCg(const vec4<T> &c)
+{
+	return {
+		c.x / T(4.0f) + c.y / T(2.0f) + c.z / T(4.0f),
+		c.x / T(2.0f) - c.z / T(2.0f),
+		-c.x / T(4.0f) + c.y / T(2.0f) - c.z / T(4.0f),
+		c.w
+	};
+}
+
+template <typename T>
+vec4<T> sample_color(const Texture &tex, float u, float v)
+{
+	return RGB_YCoCg(fromFloat4<T>(texture(tex, u, v)));
+}
+
+template <typename T>
+vec4<T> clip_aabb(const vec4<T> &aabb_min, const vec4<T> &aabb_max, const vec4<T> &p, const vec4<T> &q)
+{
+	const T eps = T(0.0001f);
+	vec4<T> r = q - p;
+	const T rmax[3] = { aabb_max.x - p.x, aabb_max.y - p.y, aabb_max.z - p.z };
+	const T rmin[3] = { aabb_min.x - p.x, aabb_min.y - p.y, aabb_min.z - p.z };
+	for (int i = 0; i < 3; i++)
+	{
+		const T ri = (&r.x)[i];
+		if (ri > rmax[i] + eps)
+			r = r * (rmax[i] / ri);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		const T ri = (&r.x)[i];
+		if (ri < rmin[i] - eps)
+			r = r * (rmin[i] / ri);
+	}
+	return p + r;
+}
+
+template <typename T>
+vec4<T> temporal_reprojection(const Shader &shader, float u, float v, float velU, float velV, float vs_dist)
+{
+	(void)vs_dist;
+	const Texture &mainTex = shader.mainTex;
+	const float uvU = u - shader.ubo.jitterUV[0];
+	const float uvV = v - shader.ubo.jitterUV[1];
+
+	const vec4<T> texel0 = sample_color<T>(mainTex, uvU, uvV);
+	vec4<T> texel1 = sample_color<T>(shader.prevTex, u - velU, v - velV);
+
+	const float du = 1.0f / mainTex.width;
+	const float dv = 1.0f / mainTex.height;
+
+	const vec4<T> ctl = sample_color<T>(mainTex, uvU - du, uvV - dv);
+	const vec4<T> ctc = sample_color<T>(mainTex, uvU, uvV - dv);
+	const vec4<T> ctr = sample_color<T>(mainTex, uvU + du, uvV - dv);
+	const vec4<T> cml = sample_color<T>(mainTex, uvU - du, uvV);
+	const vec4<T> cmc = sample_color<T>(mainTex, uvU, uvV);
+	const vec4<T> cmr = sample_color<T>(mainTex, uvU + du, uvV);
+	const vec4<T> cbl = sample_color<T>(mainTex, uvU - du, uvV + dv);
+	const vec4<T> cbc = sample_color<T>(mainTex, uvU, uvV + dv);
+	const vec4<T> cbr = sample_color<T>(mainTex, uvU + du, uvV + dv);
+
+	const vec4<T> cmin5 = min4(ctc, min4(cml, min4(cmc, min4(cmr, cbc))));
+	const vec4<T> cmax5 = max4(ctc, max4(cml, max4(cmc, max4(cmr, cbc))));
+	const vec4<T> cavg5 = (ctc + cml + cmc + cmr + cbc) / T(5.0f);
+	vec4<T> cmin = min4(ctl, min4(ctr, min4(cbl, min4(cbr, cmin5))));
+	vec4<T> cmax = max4(ctl, max4(ctr, max4(cbl, max4(cbr, cmax5))));
+	vec4<T> cavg = (ctl + ctc + ctr + cml + cmc + cmr + cbl + cbc + cbr) / T(9.0f);
+	cmin = (cmin + cmin5) * T(0.5f);
+	cmax = (cmax + cmax5) * T(0.5f);
+	cavg = (cavg + cavg5) * T(0.5f);
+
+	const T chroma_extent = T(0.25f * 0.5f) * (cmax.x - cmin.x);
+	cmin.y = texel0.y - chroma_extent;
+	cmin.z = texel0.z - chroma_extent;
+	cmax.y = texel0.y + chroma_extent;
+	cmax.z = texel0.z + chroma_extent;
+	cavg.y = texel0.y;
+	cavg.z = texel0.z;
+
+	texel1 = clip_aabb(cmin, cmax, clamp4(cavg, cmin, cmax), texel1);
+
+	const T lum0 = texel0.x;
+	const T lum1 = texel1.x;
+	const T unbiased_diff = abs1(lum0 - lum1) / std::max(lum0, std::max(lum1, T(0.2f)));
+	const T unbiased_weight = T(1.0f) - unbiased_diff;
+	const T unbiased_weight_sqr = unbiased_weight * unbiased_weight;
+	// mix() of the fp32 uniforms, only its result is converted
+	const T k_feedback = T(shader.ubo.feedbackMin + (shader.ubo.feedbackMax - shader.ubo.feedbackMin) * static_cast<float>(unbiased_weight_sqr));
+
+	return texel0 + (texel1 - texel0) * k_feedback;
+}
+
+template <typename T>
+vec4<T> resolve_color(const vec4<T> &c)
+{
+	return {
+		clamp1(c.x + c.y - c.z, T(0.0f), T(1.0f)),
+		clamp1(c.x + c.z, T(0.0f), T(1.0f)),
+		clamp1(c.x - c.y - c.z, T(0.0f), T(1.0f)),
+		c.w
+	};
+}
+
+float4 PDsrand4(float nx, float ny)
+{
+	const float s = std::sin(nx * 12.9898f + ny * 78.233f);
+	const float4 n = { fract(s * 43758.5453f), fract(s * 28001.8384f), fract(s * 50849.4141f), fract(s * 12996.89f) };
+	return n * 2.0f - float4{ 1.0f, 1.0f, 1.0f, 1.0f };
+}
+
+template <typename T>
+float4 mainImage(const Shader &shader, float u, float v)
+{
+	const float uvU = u - shader.ubo.jitterUV[0];
+	const float uvV = v - shader.ubo.jitterUV[1];
+
+	float vs_dist = 0.0f;
+	if (shader.hasDepth)
+	{
+		vs_dist = LinearizeDepth(find_closest_fragment_3x3(shader, uvU, uvV).z);
+	}
+	const float4 velocity = texture(shader.velocityBuffer, uvU, uvV) / shader.ubo.velocityScale;
+
+	const vec4<T> color_temporal = temporal_reprojection<T>(shader, u, v, velocity.x, velocity.y, vs_dist);
+	// The fp32 dither is added to the converted colour
+	const float4 to_buffer = toFloat4(resolve_color(color_temporal));
+	const float noiseOffset = shader.ubo.sinTime + 0.6959174f;
+	const float4 noise4 = PDsrand4(u + noiseOffset, v + noiseOffset) / 510.0f;
+	const float4 zero = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float4 one = { 1.0f, 1.0f, 1.0f, 1.0f };
+	return clamp4(to_buffer + noise4, zero, one);
+}
+
+inline uint8_t unorm8(float v)
+{
+	return static_cast<uint8_t>(std::floor(v * 255.0f + 0.5f));
+}
+
+} // namespace
+
+TaaReference::TaaReference(uint32_t threads)
+{
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		queues.emplace_back(new Queue);
+	}
+	scratch.resize(threads);
+	for (uint32_t i = 1; i < threads; i++)
+	{
+		workers.emplace_back(&TaaReference::workerLoop, this, i);
+	}
+}
+
+TaaReference::~TaaReference()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		quit = true;
+	}
+	jobStart.notify_all();
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+bool TaaReference::supported(Isa isa)
+{
+	switch (isa)
+	{
+	case ISA_REFERENCE:
+		return true;
+#if defined(TAA_REFERENCE_X86)
+#if defined(_MSC_VER)
+	case ISA_SSE4:
+	{
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 19)) != 0;
+	}
+	case ISA_AVX2:
+	{
+		int info[4];
+		__cpuid(info, 1);
+		// The OS has to save the ymm registers
+		const bool osxsave = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+		if (!osxsave || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+#else
+	case ISA_SSE4:
+		return __builtin_cpu_supports("sse4.1");
+	case ISA_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+#endif
+	default:
+		return false;
+	}
+}
+
+TaaReference::Isa TaaReference::bestIsa()
+{
+	if (supported(ISA_AVX2))
+		return ISA_AVX2;
+	if (supported(ISA_SSE4))
+		return ISA_SSE4;
+	return ISA_REFERENCE;
+}
+
+const char *TaaReference::isaName(Isa isa)
+{
+	switch (isa)
+	{
+	case ISA_REFERENCE: return "reference";
+	case ISA_SSE4: return "sse4.1";
+	case ISA_AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+void TaaReference::setIsa(Isa isa)
+{
+	currentIsa = supported(isa) ? isa : ISA_REFERENCE;
+}
+
+void TaaReference::workerLoop(uint32_t thread)
+{
+	uint64_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobStart.wait(lock, [&] { return quit || jobGeneration != generation; });
+			if (quit)
+				return;
+			generation = jobGeneration;
+		}
+		work(thread);
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			if (--activeWorkers == 0)
+				jobDone.notify_all();
+		}
+	}
+}
+
+void TaaReference::work(uint32_t thread)
+{
+	uint32_t band;
+	while (nextBand(thread, band))
+	{
+		job(band, thread);
+	}
+}
+
+bool TaaReference::nextBand(uint32_t thread, uint32_t &band)
+{
+	// Own queue from the front, the others from the back so owner and thief stay apart
+	{
+		Queue &queue = *queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.bands.empty())
+		{
+			band = queue.bands.front();
+			queue.bands.pop_front();
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); i++)
+	{
+		Queue &queue = *queues[(thread + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.bands.empty())
+		{
+			band = queue.bands.back();
+			queue.bands.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaaReference::run(uint32_t bandCount, const std::function<void(uint32_t band, uint32_t thread)> &bandJob)
+{
+	// Contiguous runs of bands per thread, stealing evens out the rest
+	const uint32_t threads = threadCount();
+	for (uint32_t t = 0; t < threads; t++)
+	{
+		Queue &queue = *queues[t];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (uint32_t band = bandCount * t / threads; band < bandCount * (t + 1) / threads; band++)
+		{
+			queue.bands.push_back(band);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		job = bandJob;
+		activeWorkers = static_cast<uint32_t>(workers.size());
+		jobGeneration++;
+	}
+	jobStart.notify_all();
+	work(0);
+	std::unique_lock<std::mutex> lock(jobMutex);
+	jobDone.wait(lock, [&] { return activeWorkers == 0; });
+	job = nullptr;
+}
+
+void TaaReference::resolve(const Frame &frame, const Params &params, uint8_t *output)
+{
+	if (currentIsa == ISA_REFERENCE || params.halfPrecision)
+	{
+		resolveReference(frame, params, output);
+	}
+	else
+	{
+		resolveVectorised(frame, params, output);
+	}
+}
+
+void TaaReference::resolveReference(const Frame &frame, const Params &params, uint8_t *output)
+{
+	Shader shader;
+	shader.mainTex = { frame.width, frame.height, fetchRGBA8, frame.color, 4 };
+	shader.prevTex = { frame.width, frame.height, fetchRGBA8, frame.history, 4 };
+	shader.velocityBuffer = { frame.width, frame.height, fetchFloat, frame.velocity, frame.velocityStride };
+	shader.cameraDepthTexture = { frame.width, frame.height, fetchFloat, frame.depth, 1 };
+	shader.hasDepth = frame.depth != nullptr;
+	shader.ubo = params;
+
+	float4 (*shade)(const Shader &, float, float) = params.halfPrecision ? mainImage<Half> : mainImage<float>;
+	const uint32_t bandCount = (frame.height + bandHeight - 1) / bandHeight;
+	run(bandCount, [&](uint32_t band, uint32_t) {
+		const uint32_t y1 = std::min(frame.height, (band + 1) * bandHeight);
+		for (uint32_t y = band * bandHeight; y < y1; y++)
+		{
+			for (uint32_t x = 0; x < frame.width; x++)
+			{
+				const float4 color = shade(shader, (x + 0.5f) / frame.width, (y + 0.5f) / frame.height);
+				uint8_t *texel = output + (static_cast<size_t>(y) * frame.width + x) * 4;
+				texel[0] = unorm8(color.x);
+				texel[1] = unorm8(color.y);
+				texel[2] = unorm8(color.z);
+				texel[3] = unorm8(color.w);
+			}
+		}
+	});
+}
+
+void TaaReference::resolveVectorised(const Frame &frame, const Params &params, uint8_t *output)
+{
+	const int32_t width = static_cast<int32_t>(frame.width);
+	const int32_t height = static_cast<int32_t>(frame.height);
+
+	// Every tap sits at the same subtexel position: pixel - jitter
+	const float shiftX = -params.jitterUV[0] * width;
+	const float shiftY = -params.jitterUV[1] * height;
+	const int32_t offsetX = static_cast<int32_t>(std::floor(shiftX));
+	const int32_t offsetY = static_cast<int32_t>(std::floor(shiftY));
+
+	// Border for the +-1 neighbourhood, its bilinear footprint and the jitter offset
+	const int32_t pad = 2 + std::max(std::abs(offsetX), std::abs(offsetY));
+	const int32_t stride = width + 2 * pad;
+	const int32_t rows = height + 2 * pad;
+	const size_t planeSize = static_cast<size_t>(stride) * rows + 2 * TAA_REFERENCE_MAX_LANES;
+	const size_t historySize = static_cast<size_t>(width) * height;
+	colorPlanes.resize(4 * planeSize);
+	velocityPlanes.resize(2 * planeSize);
+	historyPlanes.resize(4 * historySize);
+
+	// Planar YCoCgA with clamp to edge borders, same conversion as sample_color
+	const uint32_t prepareBands = (rows + bandHeight - 1) / bandHeight;
+	run(prepareBands, [&](uint32_t band, uint32_t) {
+		const int32_t y1 = std::min(rows, static_cast<int32_t>((band + 1) * bandHeight));
+		for (int32_t py = band * bandHeight; py < y1; py++)
+		{
+			const int32_t sy = std::min(std::max(py - pad, 0), height - 1);
+			const size_t row = static_cast<size_t>(py) * stride;
+			for (int32_t px = 0; px < stride; px++)
+			{
+				const int32_t sx = std::min(std::max(px - pad, 0), width - 1);
+				const size_t source = static_cast<size_t>(sy) * width + sx;
+				const uint8_t *texel = frame.color + source * 4;
+				const float4 c = RGB_YCoCg(float4{ texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f });
+				colorPlanes[0 * planeSize + row + px] = c.x;
+				colorPlanes[1 * planeSize + row + px] = c.y;
+				colorPlanes[2 * planeSize + row + px] = c.z;
+				colorPlanes[3 * planeSize + row + px] = c.w;
+				const float *velocity = frame.velocity + source * frame.velocityStride;
+				velocityPlanes[0 * planeSize + row + px] = velocity[0] / params.velocityScale;
+				velocityPlanes[1 * planeSize + row + px] = velocity[1] / params.velocityScale;
+			}
+			if (py < height)
+			{
+				for (int32_t x = 0; x < width; x++)
+				{
+					const size_t index = static_cast<size_t>(py) * width + x;
+					const uint8_t *texel = frame.history + index * 4;
+					const float4 c = RGB_YCoCg(float4{ texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f });
+					historyPlanes[0 * historySize + index] = c.x;
+					historyPlanes[1 * historySize + index] = c.y;
+					historyPlanes[2 * historySize + index] = c.z;
+					historyPlanes[3 * historySize + index] = c.w;
+				}
+			}
+		}
+	});
+
+	TaaReferenceBand bandTemplate = {};
+	for (int i = 0; i < 4; i++)
+	{
+		bandTemplate.color[i] = colorPlanes.data() + i * planeSize;
+		bandTemplate.history[i] = historyPlanes.data() + i * historySize;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		bandTemplate.velocity[i] = velocityPlanes.data() + i * planeSize;
+	}
+	bandTemplate.stride = stride;
+	bandTemplate.pad = pad;
+	bandTemplate.width = frame.width;
+	bandTemplate.height = frame.height;
+	bandTemplate.offsetX = offsetX;
+	bandTemplate.offsetY = offsetY;
+	bandTemplate.weightX = shiftX - offsetX;
+	bandTemplate.weightY = shiftY - offsetY;
+	bandTemplate.jitterU = params.jitterUV[0];
+	bandTemplate.jitterV = params.jitterUV[1];
+	bandTemplate.feedbackMin = params.feedbackMin;
+	bandTemplate.feedbackMax = params.feedbackMax;
+	bandTemplate.sinTime = params.sinTime;
+	bandTemplate.scratchStride = frame.width + 2 + 2 * TAA_REFERENCE_MAX_LANES;
+	bandTemplate.output = output;
+	for (auto &threadScratch : scratch)
+	{
+		threadScratch.resize(static_cast<size_t>(4) * (bandHeight + 2) * bandTemplate.scratchStride);
+	}
+
+	void (*kernel)(const TaaReferenceBand &) = nullptr;
+#if defined(TAA_REFERENCE_X86)
+	kernel = (currentIsa == ISA_AVX2) ? taaReferenceResolveAvx2 : taaReferenceResolveSse4;
+#endif
+	if (!kernel)
+	{
+		resolveReference(frame, params, output);
+		return;
+	}
+
+	const uint32_t bandCount = (frame.height + bandHeight - 1) / bandHeight;
+	run(bandCount, [&](uint32_t band, uint32_t thread) {
+		TaaReferenceBand work = bandTemplate;
+		work.y0 = band * bandHeight;
+		work.y1 = std::min(frame.height, (band + 1) * bandHeight);
+		work.scratch = scratch[thread].data();
+		kernel(work);
+	});
+}
+
+uint32_t TaaReference::compare(const uint8_t *a, const uint8_t *b, uint32_t width, uint32_t height, uint32_t tolerance, uint32_t *pixelsAboveTolerance)
+{
+	uint32_t maxDifference = 0;
+	uint32_t above = 0;
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+	{
+		uint32_t pixelDifference = 0;
+		for (size_t c = 0; c < 4; c++)
+		{
+			pixelDifference = std::max(pixelDifference, static_cast<uint32_t>(std::abs(a[i * 4 + c] - b[i * 4 + c])));
+		}
+		maxDifference = std::max(maxDifference, pixelDifference);
+		if (pixelDifference > tolerance)
+			above++;
+	}
+	if (pixelsAboveTolerance)
+		*pixelsAboveTolerance = above;
+	return maxDifference;
+}
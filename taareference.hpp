@@ -0,0 +1,117 @@
+/*
+* CPU reference of the TAA resolve
+*
+* Computes what TemprolReprojection.frag (default constants) writes into the history: the 3x3
+* YCoCg neighbourhood clamp with clip_aabb, the luminance weighted feedback and the dither.
+* ISA_REFERENCE transliterates the shader pixel by pixel and serves as the golden output,
+* the SSE4.1 and AVX2 kernels vectorise it across a row. Rows are processed in bands that
+* worker threads take from their own queue and steal from the others once it runs dry.
+* ISA_REFERENCE also emulates the fp16 colour math of the RESOLVE_FP16 shaders, to measure
+* its error against fp32.
+*
+* Inputs are the readbacks of one frame: the building color, the velocity target, the
+* previous history target and the uniforms of the resolve. All images share one size.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaaReference
+{
+public:
+	enum Isa {
+		ISA_REFERENCE = 0,
+		ISA_SSE4,
+		ISA_AVX2,
+		ISA_COUNT
+	};
+
+	struct Frame {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// RGBA8 UNORM, building color and previous history target
+		const uint8_t *color = nullptr;
+		const uint8_t *history = nullptr;
+		// Stored velocity (uv velocity * velocityScale), velocityStride floats per pixel
+		const float *velocity = nullptr;
+		uint32_t velocityStride = 2;
+		// Optional depth in [0, 1]. Only find_closest_fragment_3x3 reads it, for a distance the
+		// default variant never uses, so the vectorised kernels skip it. The GPU resolve takes
+		// that distance from the dilated velocity (velocityDilate.comp) instead
+		const float *depth = nullptr;
+	};
+
+	// Uniforms of the resolve, see UBO2 in scenerendering.cpp
+	struct Params {
+		float jitterUV[2] = { 0.0f, 0.0f };
+		float feedbackMin = 0.88f;
+		float feedbackMax = 0.97f;
+		// _SinTime.x
+		float sinTime = 0.0f;
+		// VELOCITY_SCALE specialization constant
+		float velocityScale = 1.0f;
+		// Colour math in fp16 like the RESOLVE_FP16 build of the resolves (-resolveprecision),
+		// every operation rounded. Only ISA_REFERENCE emulates it, the kernels fall back to it
+		bool halfPrecision = false;
+	};
+
+	// threads = 0 uses every hardware thread
+	explicit TaaReference(uint32_t threads = 0);
+	~TaaReference();
+
+	static bool supported(Isa isa);
+	static Isa bestIsa();
+	static const char *isaName(Isa isa);
+
+	// Unsupported instruction sets fall back to ISA_REFERENCE
+	void setIsa(Isa isa);
+	Isa isa() const { return currentIsa; }
+	uint32_t threadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+	// Writes width * height RGBA8 texels, rounded like a UNORM color attachment
+	void resolve(const Frame &frame, const Params &params, uint8_t *output);
+
+	// Largest per channel difference in 1/255 steps, and the number of pixels above tolerance
+	static uint32_t compare(const uint8_t *a, const uint8_t *b, uint32_t width, uint32_t height, uint32_t tolerance, uint32_t *pixelsAboveTolerance);
+
+private:
+	static const uint32_t bandHeight = 16;
+
+	Isa currentIsa = ISA_REFERENCE;
+
+	// Planar YCoCgA / velocity copies of the inputs, padded for the vectorised kernels
+	std::vector<float> colorPlanes, velocityPlanes, historyPlanes;
+	std::vector<std::vector<float>> scratch;
+
+	// Work stealing: every thread owns a queue of bands, the calling thread is worker 0
+	struct Queue {
+		std::mutex mutex;
+		std::deque<uint32_t> bands;
+	};
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+	std::condition_variable jobStart, jobDone;
+	std::function<void(uint32_t band, uint32_t thread)> job;
+	uint64_t jobGeneration = 0;
+	uint32_t activeWorkers = 0;
+	bool quit = false;
+
+	void workerLoop(uint32_t thread);
+	void work(uint32_t thread);
+	bool nextBand(uint32_t thread, uint32_t &band);
+	void run(uint32_t bandCount, const std::function<void(uint32_t band, uint32_t thread)> &bandJob);
+
+	void resolveReference(const Frame &frame, const Params &params, uint8_t *output);
+	void resolveVectorised(const Frame &frame, const Params &params, uint8_t *output);
+};
@@ -0,0 +1,55 @@
+/*
+* AVX2 kernel of the TAA CPU reference, 8 pixels per iteration
+*
+* Built without FMA contraction so the rounding matches the SSE4.1 kernel.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "taareference_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+constexpr int32_t LANES = 8;
+
+struct Vec {
+	__m256 v;
+};
+
+struct IVec {
+	__m256i v;
+};
+
+inline Vec operator+(Vec a, Vec b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Vec operator-(Vec a, Vec b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Vec operator*(Vec a, Vec b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Vec operator/(Vec a, Vec b) { return { _mm256_div_ps(a.v, b.v) }; }
+
+inline Vec set1(float f) { return { _mm256_set1_ps(f) }; }
+inline Vec loadu(const float *p) { return { _mm256_loadu_ps(p) }; }
+inline void storeu(float *p, Vec a) { _mm256_storeu_ps(p, a.v); }
+inline Vec ramp() { return { _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f) }; }
+
+inline Vec vmin(Vec a, Vec b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Vec vmax(Vec a, Vec b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Vec vabs(Vec a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline Vec vfloor(Vec a) { return { _mm256_floor_ps(a.v) }; }
+
+// Masks, select(mask, a, b) picks a where the mask is set
+inline Vec gt(Vec a, Vec b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline Vec lt(Vec a, Vec b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline Vec select(Vec mask, Vec a, Vec b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+
+inline IVec toInt(Vec a) { return { _mm256_cvttps_epi32(a.v) }; }
+inline IVec addi(IVec a, int32_t b) { return { _mm256_add_epi32(a.v, _mm256_set1_epi32(b)) }; }
+inline IVec clampi(IVec a, int32_t lo, int32_t hi) { return { _mm256_min_epi32(_mm256_max_epi32(a.v, _mm256_set1_epi32(lo)), _mm256_set1_epi32(hi)) }; }
+inline IVec index(IVec y, int32_t stride, IVec x) { return { _mm256_add_epi32(_mm256_mullo_epi32(y.v, _mm256_set1_epi32(stride)), x.v) }; }
+
+inline Vec gather(const float *base, IVec i) { return { _mm256_i32gather_ps(base, i.v, 4) }; }
+
+} // namespace
+
+#define TAA_REFERENCE_KERNEL taaReferenceResolveAvx2
+#include "taareference_kernel.inl"
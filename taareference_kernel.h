@@ -0,0 +1,47 @@
+/*
+* Band interface between TaaReference and its vectorised kernels
+*
+* Each kernel lives in its own translation unit compiled for its instruction set
+* (taareference_sse4.cpp, taareference_avx2.cpp) and only runs after a CPU check.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+struct TaaReferenceBand {
+	// Planar YCoCgA color and velocity (divided by the velocity scale), `pad` texels of
+	// clamp to edge border on every side and rows of `stride` floats
+	const float *color[4];
+	const float *velocity[2];
+	uint32_t stride;
+	uint32_t pad;
+	// Planar YCoCgA history, width * height without border
+	const float *history[4];
+	uint32_t width, height;
+
+	// All neighbourhood taps share one bilinear footprint: top left texel at pixel + offset,
+	// filter weights below
+	int32_t offsetX, offsetY;
+	float weightX, weightY;
+
+	float jitterU, jitterV;
+	float feedbackMin, feedbackMax;
+	float sinTime;
+
+	// Rows [y0, y1), scratch holds 4 * (y1 - y0 + 2) rows of scratchStride floats
+	uint32_t y0, y1;
+	float *scratch;
+	uint32_t scratchStride;
+
+	// RGBA8, width * height
+	uint8_t *output;
+};
+
+// Lanes of the widest kernel, rows and planes carry this much slack for full width loads
+#define TAA_REFERENCE_MAX_LANES 8
+
+void taaReferenceResolveSse4(const TaaReferenceBand &band);
+void taaReferenceResolveAvx2(const TaaReferenceBand &band);
@@ -0,0 +1,244 @@
+/*
+* Vectorised TAA resolve, included by the per instruction set translation units
+*
+* The including file defines LANES, Vec, IVec and their operations inside an anonymous
+* namespace, plus TAA_REFERENCE_KERNEL as the name of the exported entry point.
+*
+* The jitter is the same for every pixel, so every neighbourhood tap of the shader has the
+* same bilinear weights. Each band first filters the YCoCgA rows it needs once, the 3x3
+* neighbourhood then reads the filtered rows at -1, 0 and +1. The history tap follows the
+* per pixel velocity and is gathered.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+namespace {
+
+inline Vec lerp(Vec a, Vec b, Vec t)
+{
+	return a + (b - a) * t;
+}
+
+inline Vec vclamp(Vec x, Vec lo, Vec hi)
+{
+	return vmin(vmax(x, lo), hi);
+}
+
+inline Vec fract(Vec x)
+{
+	return x - vfloor(x);
+}
+
+// sin for the dither, |x| up to a few hundred: reduce to [-pi, pi], fold to [-pi/2, pi/2]
+// and evaluate the Taylor series to x^11, about 1e-7 off
+inline Vec vsin(Vec x)
+{
+	const Vec k = vfloor(x * set1(0.159154943f) + set1(0.5f));
+	// 2 pi in two parts, the first one is exact for the multiples used here
+	x = x - k * set1(6.28125f) - k * set1(1.93530717e-3f);
+	const Vec pi = set1(3.14159265f);
+	const Vec halfPi = set1(1.57079633f);
+	x = select(gt(x, halfPi), pi - x, x);
+	x = select(lt(x, set1(0.0f) - halfPi), set1(0.0f) - pi - x, x);
+	const Vec x2 = x * x;
+	Vec p = set1(-2.50521084e-8f);
+	p = p * x2 + set1(2.75573192e-6f);
+	p = p * x2 + set1(-1.98412698e-4f);
+	p = p * x2 + set1(8.33333333e-3f);
+	p = p * x2 + set1(-1.66666667e-1f);
+	return x + x * x2 * p;
+}
+
+struct Vec4 {
+	Vec c[4];
+};
+
+} // namespace
+
+void TAA_REFERENCE_KERNEL(const TaaReferenceBand &band)
+{
+	const int32_t width = static_cast<int32_t>(band.width);
+	const int32_t height = static_cast<int32_t>(band.height);
+	const int32_t y0 = static_cast<int32_t>(band.y0);
+	const int32_t y1 = static_cast<int32_t>(band.y1);
+	const int32_t stride = static_cast<int32_t>(band.stride);
+	const int32_t pad = static_cast<int32_t>(band.pad);
+	const Vec weightX = set1(band.weightX);
+	const Vec weightY = set1(band.weightY);
+
+	// Filtered YCoCgA rows y0 - 1 .. y1, column c stored at c + 1
+	auto filteredRow = [&](int32_t row, int channel) {
+		return band.scratch + ((row - (y0 - 1)) * 4 + channel) * band.scratchStride;
+	};
+	for (int32_t row = y0 - 1; row <= y1; row++)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			const float *top = band.color[channel] + (row + band.offsetY + pad) * stride + pad + band.offsetX;
+			const float *bottom = top + stride;
+			float *filtered = filteredRow(row, channel) + 1;
+			for (int32_t x = -1; x <= width; x += LANES)
+			{
+				const Vec t = lerp(loadu(top + x), loadu(top + x + 1), weightX);
+				const Vec b = lerp(loadu(bottom + x), loadu(bottom + x + 1), weightX);
+				storeu(filtered + x, lerp(t, b, weightY));
+			}
+		}
+	}
+
+	const Vec invWidth = set1(1.0f / width);
+	const Vec invHeight = set1(1.0f / height);
+	const Vec widthF = set1(static_cast<float>(width));
+	const Vec heightF = set1(static_cast<float>(height));
+	const Vec half = set1(0.5f);
+	const Vec zero = set1(0.0f);
+	const Vec one = set1(1.0f);
+	const Vec eps = set1(0.0001f);
+	const Vec feedbackMin = set1(band.feedbackMin);
+	const Vec feedbackRange = set1(band.feedbackMax - band.feedbackMin);
+
+	for (int32_t y = y0; y < y1; y++)
+	{
+		const float *rows[3][4];
+		for (int dy = 0; dy < 3; dy++)
+			for (int channel = 0; channel < 4; channel++)
+				rows[dy][channel] = filteredRow(y - 1 + dy, channel) + 1;
+		const float *velocityTop[2];
+		for (int channel = 0; channel < 2; channel++)
+			velocityTop[channel] = band.velocity[channel] + (y + band.offsetY + pad) * stride + pad + band.offsetX;
+		const Vec ssV = (set1(static_cast<float>(y)) + half) * invHeight;
+
+		for (int32_t x = 0; x < width; x += LANES)
+		{
+			// 3x3 neighbourhood, plus cross of 5
+			Vec4 cmin, cmax, cavg, cmin5, cmax5, cavg5, texel0;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				const Vec ctl = loadu(rows[0][channel] + x - 1);
+				const Vec ctc = loadu(rows[0][channel] + x);
+				const Vec ctr = loadu(rows[0][channel] + x + 1);
+				const Vec cml = loadu(rows[1][channel] + x - 1);
+				const Vec cmc = loadu(rows[1][channel] + x);
+				const Vec cmr = loadu(rows[1][channel] + x + 1);
+				const Vec cbl = loadu(rows[2][channel] + x - 1);
+				const Vec cbc = loadu(rows[2][channel] + x);
+				const Vec cbr = loadu(rows[2][channel] + x + 1);
+
+				texel0.c[channel] = cmc;
+				cmin5.c[channel] = vmin(ctc, vmin(cml, vmin(cmc, vmin(cmr, cbc))));
+				cmax5.c[channel] = vmax(ctc, vmax(cml, vmax(cmc, vmax(cmr, cbc))));
+				cavg5.c[channel] = (ctc + cml + cmc + cmr + cbc) / set1(5.0f);
+				cmin.c[channel] = vmin(ctl, vmin(ctr, vmin(cbl, vmin(cbr, cmin5.c[channel]))));
+				cmax.c[channel] = vmax(ctl, vmax(ctr, vmax(cbl, vmax(cbr, cmax5.c[channel]))));
+				cavg.c[channel] = (ctl + ctc + ctr + cml + cmc + cmr + cbl + cbc + cbr) / set1(9.0f);
+
+				cmin.c[channel] = half * (cmin.c[channel] + cmin5.c[channel]);
+				cmax.c[channel] = half * (cmax.c[channel] + cmax5.c[channel]);
+				cavg.c[channel] = half * (cavg.c[channel] + cavg5.c[channel]);
+			}
+
+			// Chroma extent follows the luma extent
+			const Vec chromaExtent = set1(0.25f * 0.5f) * (cmax.c[0] - cmin.c[0]);
+			for (int channel = 1; channel < 3; channel++)
+			{
+				cmin.c[channel] = texel0.c[channel] - chromaExtent;
+				cmax.c[channel] = texel0.c[channel] + chromaExtent;
+				cavg.c[channel] = texel0.c[channel];
+			}
+
+			// History tap at ss_txc - ss_vel, velocity sampled at the jittered position
+			Vec velocity[2];
+			for (int channel = 0; channel < 2; channel++)
+			{
+				const float *top = velocityTop[channel] + x;
+				const Vec t = lerp(loadu(top), loadu(top + 1), weightX);
+				const Vec b = lerp(loadu(top + stride), loadu(top + stride + 1), weightX);
+				velocity[channel] = lerp(t, b, weightY);
+			}
+			const Vec ssU = (set1(static_cast<float>(x)) + ramp() + half) * invWidth;
+			// Clamped to a texel past the border so the conversion stays in range
+			const Vec hx = vclamp((ssU - velocity[0]) * widthF - half, set1(-2.0f), widthF + one);
+			const Vec hy = vclamp((ssV - velocity[1]) * heightF - half, set1(-2.0f), heightF + one);
+			const Vec hx0 = vfloor(hx);
+			const Vec hy0 = vfloor(hy);
+			const Vec hwx = hx - hx0;
+			const Vec hwy = hy - hy0;
+			const IVec ix = toInt(hx0);
+			const IVec iy = toInt(hy0);
+			const IVec ix0 = clampi(ix, 0, width - 1);
+			const IVec ix1 = clampi(addi(ix, 1), 0, width - 1);
+			const IVec iy0 = clampi(iy, 0, height - 1);
+			const IVec iy1 = clampi(addi(iy, 1), 0, height - 1);
+			const IVec i00 = index(iy0, width, ix0);
+			const IVec i01 = index(iy0, width, ix1);
+			const IVec i10 = index(iy1, width, ix0);
+			const IVec i11 = index(iy1, width, ix1);
+			Vec4 texel1;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				const float *history = band.history[channel];
+				const Vec t = lerp(gather(history, i00), gather(history, i01), hwx);
+				const Vec b = lerp(gather(history, i10), gather(history, i11), hwx);
+				texel1.c[channel] = lerp(t, b, hwy);
+			}
+
+			// clip_aabb towards clamp(cavg, cmin, cmax)
+			Vec4 p, r;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				p.c[channel] = vclamp(cavg.c[channel], cmin.c[channel], cmax.c[channel]);
+				r.c[channel] = texel1.c[channel] - p.c[channel];
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const Vec rmax = cmax.c[axis] - p.c[axis];
+				const Vec scale = select(gt(r.c[axis], rmax + eps), rmax / r.c[axis], one);
+				for (int channel = 0; channel < 4; channel++)
+					r.c[channel] = r.c[channel] * scale;
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const Vec rmin = cmin.c[axis] - p.c[axis];
+				const Vec scale = select(lt(r.c[axis], rmin - eps), rmin / r.c[axis], one);
+				for (int channel = 0; channel < 4; channel++)
+					r.c[channel] = r.c[channel] * scale;
+			}
+			for (int channel = 0; channel < 4; channel++)
+				texel1.c[channel] = p.c[channel] + r.c[channel];
+
+			// Luminance weighted feedback
+			const Vec lum0 = texel0.c[0];
+			const Vec lum1 = texel1.c[0];
+			const Vec unbiasedDiff = vabs(lum0 - lum1) / vmax(lum0, vmax(lum1, set1(0.2f)));
+			const Vec unbiasedWeight = one - unbiasedDiff;
+			const Vec feedback = feedbackMin + feedbackRange * (unbiasedWeight * unbiasedWeight);
+			Vec4 color;
+			for (int channel = 0; channel < 4; channel++)
+				color.c[channel] = texel0.c[channel] + (texel1.c[channel] - texel0.c[channel]) * feedback;
+
+			// YCoCg to RGB
+			Vec4 result;
+			result.c[0] = vclamp(color.c[0] + color.c[1] - color.c[2], zero, one);
+			result.c[1] = vclamp(color.c[0] + color.c[2], zero, one);
+			result.c[2] = vclamp(color.c[0] - color.c[1] - color.c[2], zero, one);
+			result.c[3] = color.c[3];
+
+			// Dither
+			const Vec noiseOffset = set1(band.sinTime + 0.6959174f);
+			const Vec s = vsin((ssU + noiseOffset) * set1(12.9898f) + (ssV + noiseOffset) * set1(78.233f));
+			const float noiseScale[4] = { 43758.5453f, 28001.8384f, 50849.4141f, 12996.89f };
+			float lanes[4][LANES];
+			for (int channel = 0; channel < 4; channel++)
+			{
+				const Vec noise = (fract(s * set1(noiseScale[channel])) * set1(2.0f) - one) / set1(510.0f);
+				storeu(lanes[channel], vfloor(vclamp(result.c[channel] + noise, zero, one) * set1(255.0f) + half));
+			}
+
+			uint8_t *output = band.output + (static_cast<size_t>(y) * width + x) * 4;
+			const int32_t count = (width - x < LANES) ? width - x : LANES;
+			for (int32_t lane = 0; lane < count; lane++)
+				for (int channel = 0; channel < 4; channel++)
+					output[lane * 4 + channel] = static_cast<uint8_t>(lanes[channel][lane]);
+		}
+	}
+}
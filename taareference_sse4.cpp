@@ -0,0 +1,59 @@
+/*
+* SSE4.1 kernel of the TAA CPU reference, 4 pixels per iteration
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "taareference_kernel.h"
+
+#include <smmintrin.h>
+
+namespace {
+
+constexpr int32_t LANES = 4;
+
+struct Vec {
+	__m128 v;
+};
+
+struct IVec {
+	__m128i v;
+};
+
+inline Vec operator+(Vec a, Vec b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Vec operator-(Vec a, Vec b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Vec operator*(Vec a, Vec b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Vec operator/(Vec a, Vec b) { return { _mm_div_ps(a.v, b.v) }; }
+
+inline Vec set1(float f) { return { _mm_set1_ps(f) }; }
+inline Vec loadu(const float *p) { return { _mm_loadu_ps(p) }; }
+inline void storeu(float *p, Vec a) { _mm_storeu_ps(p, a.v); }
+inline Vec ramp() { return { _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) }; }
+
+inline Vec vmin(Vec a, Vec b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Vec vmax(Vec a, Vec b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Vec vabs(Vec a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline Vec vfloor(Vec a) { return { _mm_floor_ps(a.v) }; }
+
+// Masks, select(mask, a, b) picks a where the mask is set
+inline Vec gt(Vec a, Vec b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline Vec lt(Vec a, Vec b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Vec select(Vec mask, Vec a, Vec b) { return { _mm_blendv_ps(b.v, a.v, mask.v) }; }
+
+inline IVec toInt(Vec a) { return { _mm_cvttps_epi32(a.v) }; }
+inline IVec addi(IVec a, int32_t b) { return { _mm_add_epi32(a.v, _mm_set1_epi32(b)) }; }
+inline IVec clampi(IVec a, int32_t lo, int32_t hi) { return { _mm_min_epi32(_mm_max_epi32(a.v, _mm_set1_epi32(lo)), _mm_set1_epi32(hi)) }; }
+inline IVec index(IVec y, int32_t stride, IVec x) { return { _mm_add_epi32(_mm_mullo_epi32(y.v, _mm_set1_epi32(stride)), x.v) }; }
+
+// No gather before AVX2
+inline Vec gather(const float *base, IVec i)
+{
+	alignas(16) int32_t indices[4];
+	_mm_store_si128(reinterpret_cast<__m128i *>(indices), i.v);
+	return { _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]) };
+}
+
+} // namespace
+
+#define TAA_REFERENCE_KERNEL taaReferenceResolveSse4
+#include "taareference_kernel.inl"